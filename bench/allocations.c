@@ -0,0 +1,39 @@
+#include <stdlib.h>
+#include "allocations.h"
+
+static size_t count = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+int __real_posix_memalign(void **pointer, size_t alignment, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  count++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  count++;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  count++;
+  return __real_realloc(pointer, size);
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+  count++;
+  return __real_aligned_alloc(alignment, size);
+}
+
+int __wrap_posix_memalign(void **pointer, size_t alignment, size_t size) {
+  count++;
+  return __real_posix_memalign(pointer, alignment, size);
+}
+
+size_t allocations(void) {
+  return count;
+}
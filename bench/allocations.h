@@ -0,0 +1,14 @@
+#ifndef ALLOCATIONS
+#define ALLOCATIONS
+
+#include <stddef.h>
+
+/**
+ * Number of calls to malloc, calloc, realloc, aligned_alloc and
+ * posix_memalign since the program started. Benchmarks are linked with
+ * --wrap for each of these, so every call from the editor's code is counted,
+ * including the slabs of the pools (see pool.h).
+ */
+size_t allocations(void);
+
+#endif
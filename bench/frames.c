@@ -0,0 +1,128 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <time.h>
+#include "allocations.h"
+#include "../source/appendBuffer.h"
+#include "../source/display.h"
+#include "../source/editorRow.h"
+#include "../source/fileData.h"
+#include "../source/rowTree.h"
+#include "../source/screen.h"
+#include "../source/zipperBuffer.h"
+
+#define ROWS 100000
+#define HEIGHT 100
+#define WIDTH 300
+#define FRAMES 20000
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *name, long frames, size_t before, double start) {
+  double elapsed = now() - start;
+  printf("%-24s %10ld frames %8.2f us/frame %6.3f allocations/frame\n", name,
+         frames, elapsed / frames / 1e3, (double)(allocations() - before) / frames);
+}
+
+/**
+ * Copy a laid out frame into the screen, the way editorDrawRows does.
+ */
+static void compose(Screen *screen, Frame *frame) {
+  screenStart(screen);
+  for (int y = 0; y < frame->height; y++) {
+    int charactersDrawn = 0;
+    for (int i = 0; i < frame->lines[y].count; i++) {
+      PaneRow *row = &frame->rows[frame->lines[y].start + i];
+      int available = WIDTH - charactersDrawn;
+      int width = row->width > available ? available : row->width;
+      int total = row->width + row->blanks > available ? available : row->width + row->blanks;
+      if (row->reverse) screenWrite(screen, "\x1b[7m", 4);
+      screenWrite(screen, row->row, width);
+      screenBlanks(screen, total - width);
+      if (row->reverse) screenWrite(screen, "\x1b[27m", 5);
+      charactersDrawn += total;
+    }
+    screenNewline(screen);
+  }
+}
+
+int main(void) {
+  static EditorRow *rows[ROWS];
+  char line[64];
+  for (int i = 0; i < ROWS; i++) {
+    int length = snprintf(line, sizeof(line), "\tline %d of the buffer,\twith tabs", i);
+    rows[i] = newRowCopy(line, length, 8);
+    // rows render the first time they're shown; that's not the frame's doing
+    editorRowRender(rows[i]);
+  }
+  ZipperBuffer *buffer = zipperBuffer(rowTreeFromArray(rows, ROWS), 0);
+  FileData *file = fileData(0, 0, ROWS, buffer, "frames.txt", 0, NULL, NULL);
+  // two panes side by side above one full-width pane
+  Pane *left = makePane(0, 0, 0, 0, file);
+  Pane *right = makePane(0, 0, 0, 0, file);
+  Pane *below = makePane(0, 0, 0, 0, file);
+  DisplayRow *top = makeDisplayRow(ListF(Pane).cons(left, NULL), right, NULL);
+  DisplayRow *bottom = makeDisplayRow(NULL, below, NULL);
+  DisplayColumn *column = makeDisplayColumn(NULL, top, ListF(DisplayRow).cons(bottom, NULL));
+
+  Frame frame = FRAME_INIT;
+  Screen screen = {0};
+  screenResize(&screen, HEIGHT, WIDTH);
+  drawDisplayColumn(&frame, column, HEIGHT, WIDTH);
+  long sum = 0;
+
+  size_t before = allocations();
+  double start = now();
+  for (long i = 0; i < FRAMES; i++) {
+    left->top = i % ROWS;
+    right->top = i * 7 % ROWS;
+    below->top = i * 13 % ROWS;
+    drawDisplayColumn(&frame, column, HEIGHT, WIDTH);
+    sum += frame.rows[0].width;
+  }
+  report("layout", FRAMES, before, start);
+  size_t layoutAllocations = allocations() - before;
+
+  before = allocations();
+  start = now();
+  for (long i = 0; i < FRAMES; i++) {
+    left->top = i % ROWS;
+    right->top = i * 7 % ROWS;
+    below->top = i * 13 % ROWS;
+    drawDisplayColumn(&frame, column, HEIGHT, WIDTH);
+    compose(&screen, &frame);
+    sum += screen.text[0];
+  }
+  report("layout and compose", FRAMES, before, start);
+  size_t composeAllocations = allocations() - before;
+
+  // every frame scrolls every pane, so the whole screen changes each time
+  struct abuf out = ABUF_INIT;
+  screen.eraseCharacters = true;
+  compose(&screen, &frame);
+  screenFlush(&screen, &out);
+  before = allocations();
+  start = now();
+  for (long i = 0; i < FRAMES; i++) {
+    left->top = i % ROWS;
+    right->top = i * 7 % ROWS;
+    below->top = i * 13 % ROWS;
+    drawDisplayColumn(&frame, column, HEIGHT, WIDTH);
+    compose(&screen, &frame);
+    abClear(&out);
+    screenFlush(&screen, &out);
+    sum += out.len;
+  }
+  report("whole frame", FRAMES, before, start);
+  size_t flushAllocations = allocations() - before;
+  printf("%-24s %10zu bytes for the last frame\n", "output", out.len);
+
+  if (layoutAllocations > 0 || composeAllocations > 0 || flushAllocations > 0) {
+    printf("frames allocated after the first\n");
+    return 1;
+  }
+  return sum == 0;
+}
@@ -0,0 +1,71 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "allocations.h"
+#include "../source/editorRow.h"
+#include "../source/rowTree.h"
+#include "../source/zipperBuffer.h"
+
+#define ROWS 1000000
+#define MOVES 10000000
+#define PAGE 50
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *name, long moves, size_t before, double start) {
+  double elapsed = now() - start;
+  printf("%-24s %10ld moves %8.2f ns/move %6.3f allocations/move\n", name, moves,
+         elapsed / moves, (double)(allocations() - before) / moves);
+}
+
+int main(void) {
+  static EditorRow *rows[ROWS];
+  char line[32];
+  for (int i = 0; i < ROWS; i++) {
+    int length = snprintf(line, sizeof(line), "line %d\tof the buffer", i);
+    rows[i] = newRowCopy(line, length, 8);
+  }
+  ZipperBuffer *buffer = zipperBuffer(rowTreeFromArray(rows, ROWS), 0);
+  long sum = 0;
+
+  size_t before = allocations();
+  double start = now();
+  for (long i = 0; i < MOVES; i++) {
+    if (i / ROWS % 2 == 0) {
+      zipperForwardRow(buffer);
+    } else {
+      zipperBackwardRow(buffer);
+    }
+    EditorRow *row = zipperCurrentRow(buffer);
+    sum += row == NULL ? 0 : row->size;
+  }
+  report("line up/down", MOVES, before, start);
+
+  before = allocations();
+  start = now();
+  long pages = MOVES / PAGE;
+  for (long i = 0; i < pages; i++) {
+    zipperJumpTo(buffer, (int)(i * PAGE * 7919 % ROWS));
+    EditorRow *row = zipperCurrentRow(buffer);
+    sum += row == NULL ? 0 : row->size;
+  }
+  report("page jump", pages, before, start);
+
+  before = allocations();
+  start = now();
+  for (long i = 0; i < pages; i++) {
+    RowIterator screen = zipperRowsFrom(buffer, (int)(i * PAGE * 7919 % ROWS));
+    for (int j = 0; j < PAGE; j++) {
+      EditorRow *row = rowIteratorNext(&screen);
+      sum += row == NULL ? 0 : row->size;
+    }
+  }
+  report("screen of rows", pages, before, start);
+
+  return sum == 0;
+}
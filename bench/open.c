@@ -0,0 +1,176 @@
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "../source/editorRow.h"
+#include "../source/lines.h"
+#include "../source/mappedFile.h"
+#include "../source/rowTree.h"
+
+#define SIZE (1L << 30)
+#define BLOCK (1 << 16)
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void report(const char *name, size_t lines, double start) {
+  double seconds = (now() - start) / 1e9;
+  printf("  %-26s %9zu lines %8.0f MB/s\n", name, lines, SIZE / seconds / 1e6);
+}
+
+/**
+ * Write SIZE bytes of lines between 0 and 127 characters long, with the odd
+ * tab.
+ */
+static void makeFile(const char *path) {
+  FILE *f = fopen(path, "w");
+  char *block = malloc(1 << 20);
+  unsigned int seed = 1;
+  for (long written = 0; written < SIZE; written += 1 << 20) {
+    for (int i = 0; i < 1 << 20; i++) {
+      seed = seed * 1103515245 + 12345;
+      int r = (seed >> 16) & 127;
+      block[i] = r == 0 ? '\n' : r == 1 ? '\t' : 'a' + r % 26;
+    }
+    fwrite(block, 1, 1 << 20, f);
+  }
+  free(block);
+  fclose(f);
+}
+
+/**
+ * Index lines the way mappedFile used to, with a memchr for each line.
+ */
+static size_t indexMemchr(const char *data, size_t *lines) {
+  size_t count = 0;
+  size_t start = 0;
+  while (start < SIZE) {
+    lines[count++] = start;
+    const char *newline = memchr(data + start, '\n', SIZE - start);
+    start = newline == NULL ? SIZE : (size_t)(newline - data) + 1;
+  }
+  return count;
+}
+
+static size_t indexWith(const LineKernels *k, const char *data, size_t *lines) {
+  size_t count = 1;
+  lines[0] = 0;
+  for (size_t offset = 0; offset < SIZE; offset += BLOCK) {
+    count += k->split(data + offset, BLOCK, offset, lines + count);
+  }
+  return count;
+}
+
+/**
+ * Read rows the way editorOpen used to, with getline.
+ */
+static RowTree *readGetline(const char *path, int *count) {
+  FILE *fp = fopen(path, "r");
+  char *line = NULL;
+  size_t linecap = 0;
+  ssize_t lineLength;
+  int rowCapacity = 1024;
+  int rowCount = 0;
+  EditorRow **rows = malloc(rowCapacity * sizeof(EditorRow *));
+  while ((lineLength = getline(&line, &linecap, fp)) != -1) {
+    while (lineLength > 0 &&
+           (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
+      lineLength--;
+    }
+    if (rowCount == rowCapacity) {
+      rowCapacity *= 2;
+      rows = realloc(rows, rowCapacity * sizeof(EditorRow *));
+    }
+    rows[rowCount++] = newRowCopy(line, lineLength, 4);
+  }
+  RowTree *tree = rowTreeFromArray(rows, rowCount);
+  free(rows);
+  free(line);
+  fclose(fp);
+  *count = rowCount;
+  return tree;
+}
+
+int main(void) {
+  const char *directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/kibi-open-bench.txt", directory);
+  makeFile(path);
+  printf("Opening a %ld MB file:\n", SIZE >> 20);
+
+  int fileDescriptor = open(path, O_RDONLY);
+  char *data = mmap(NULL, SIZE, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fileDescriptor, 0);
+  close(fileDescriptor);
+  size_t *lines = malloc((SIZE / 64) * sizeof(size_t));
+  double start = now();
+  size_t count = indexMemchr(data, lines);
+  report("index, memchr per line", count, start);
+  const LineKernels *kernels[] = {&scalarLineKernels, lineKernels()};
+  char name[32];
+  for (int k = 0; k < 2; k++) {
+    snprintf(name, sizeof(name), "index, %s", kernels[k]->name);
+    start = now();
+    count = indexWith(kernels[k], data, lines);
+    report(name, count, start);
+  }
+  free(lines);
+
+  // the same text on more and more threads, up to one per CPU
+  int most = indexThreads(SIZE);
+  for (int threads = 1;; threads = threads * 2 < most ? threads * 2 : most) {
+    int64_t indexed;
+    start = now();
+    free(indexLines(data, SIZE, threads, &indexed));
+    snprintf(name, sizeof(name), "index, %d threads", threads);
+    report(name, indexed, start);
+    if (threads == most) break;
+  }
+  munmap(data, SIZE);
+
+  start = now();
+  fileDescriptor = open(path, O_RDONLY);
+  MappedFile *file = mappedFile(fileDescriptor, 4);
+  while (!mappedFileIndexed(file)) {
+    mappedFileIndex(file, mappedFileIndexChunk());
+  }
+  RowTree *tree = rowTreeFromMappedFile(file);
+  close(fileDescriptor);
+  snprintf(name, sizeof(name), "open, mapped, %d threads",
+           indexThreads(mappedFileIndexChunk()));
+  report(name, rowTreeLength(tree), start);
+  rowTreeRelease(tree);
+  mappedFileRelease(file);
+
+  // each in a new process, so that neither gets the memory the other freed
+  fflush(stdout);
+  if (fork() == 0) {
+    int64_t rowCount;
+    start = now();
+    fileDescriptor = open(path, O_RDONLY);
+    EditorRow **rows = readLines(fileDescriptor, 4, &rowCount);
+    tree = rowTreeFromArray(rows, rowCount);
+    close(fileDescriptor);
+    report("open, read in blocks", rowCount, start);
+    return 0;
+  }
+  wait(NULL);
+  if (fork() == 0) {
+    int rowCount;
+    start = now();
+    tree = readGetline(path, &rowCount);
+    report("open, getline", rowCount, start);
+    return 0;
+  }
+  wait(NULL);
+
+  remove(path);
+  return 0;
+}
@@ -0,0 +1,97 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../source/tabs.h"
+
+#define LENGTH (1 << 20)
+#define PASSES 200
+
+static double now(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * Expand tabs the way editorUpdateRow used to, a character at a time.
+ */
+static int expandLoop(const char *s, int length, int tabSize, char *out) {
+  int i = 0;
+  for (int j = 0; j < length; j++) {
+    if (s[j] == '\t') {
+      for (int size = tabSize; size > 0; size--) {
+        out[i++] = ' ';
+      }
+    } else {
+      out[i++] = s[j];
+    }
+  }
+  return i;
+}
+
+/**
+ * expandTabs, but with the given kernels rather than the dispatched ones.
+ */
+static size_t expandWith(const TabKernels *k, const char *s, size_t length, int tabSize, char *out) {
+  char *start = out;
+  size_t i = 0;
+  while (i < length) {
+    size_t run = k->find(s + i, length - i);
+    memcpy(out, s + i, run);
+    out += run;
+    i += run;
+    if (i < length) {
+      memset(out, ' ', tabSize);
+      out += tabSize;
+      i++;
+    }
+  }
+  return out - start;
+}
+
+static double throughput(double start) {
+  return (double)LENGTH * PASSES / ((now() - start) / 1e9) / 1e6;
+}
+
+static void run(const char *line, const char *description) {
+  const TabKernels *kernels[] = {&scalarTabKernels, tabKernels()};
+  char *out = malloc(LENGTH * 8);
+  long sum = 0;
+  printf("%s:\n", description);
+  for (int k = 0; k < 2; k++) {
+    double start = now();
+    for (int p = 0; p < PASSES; p++) {
+      sum += kernels[k]->count(line, LENGTH - p);
+    }
+    double count = throughput(start);
+    start = now();
+    for (int p = 0; p < PASSES; p++) {
+      sum += expandWith(kernels[k], line, LENGTH - p, 8, out);
+    }
+    double expand = throughput(start);
+    printf("  %-8s count %8.0f MB/s   expand %8.0f MB/s\n", kernels[k]->name, count, expand);
+  }
+  double start = now();
+  for (int p = 0; p < PASSES; p++) {
+    sum += expandLoop(line, LENGTH - p, 8, out);
+  }
+  printf("  %-8s                       expand %8.0f MB/s\n", "loop", throughput(start));
+  free(out);
+  if (sum == 0) printf("\n");
+}
+
+int main(void) {
+  char *line = malloc(LENGTH);
+  for (int i = 0; i < LENGTH; i++) {
+    line[i] = i % 37 == 0 ? '\t' : 'a' + i % 26;
+  }
+  run(line, "1MB line, a tab every 37 characters");
+  for (int i = 0; i < LENGTH; i++) {
+    line[i] = i % 4096 == 0 ? '\t' : 'a' + i % 26;
+  }
+  run(line, "1MB line, a tab every 4096 characters");
+  free(line);
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "appendBuffer.h"
+
+char *abReserve(struct abuf *ab, size_t len) {
+  if (ab->capacity - ab->len < len) {
+    size_t capacity = ab->capacity == 0 ? 4096 : ab->capacity;
+    while (capacity - ab->len < len) {
+      capacity *= 2;
+    }
+    char *new = realloc(ab->b, capacity);
+    if (new == NULL) {
+      return NULL;
+    }
+    ab->b = new;
+    ab->capacity = capacity;
+  }
+  return ab->b + ab->len;
+}
+
+void abCommit(struct abuf *ab, size_t len) {
+  ab->len += len;
+}
+
+void abAppend(struct abuf *ab, const char *s, size_t len) {
+  char *span = abReserve(ab, len);
+
+  if (span == NULL) {
+    return;
+  }
+  memcpy(span, s, len);
+  ab->len += len;
+}
+
+void abClear(struct abuf *ab) {
+  ab->len = 0;
+}
+
+void abFree(struct abuf *ab) {
+  free(ab->b);
+  ab->b = NULL;
+  ab->len = 0;
+  ab->capacity = 0;
+}
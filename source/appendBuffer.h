@@ -0,0 +1,44 @@
+#ifndef APPEND_BUFFER
+#define APPEND_BUFFER
+
+#include <stddef.h>
+
+/**
+ * Output gathered up to be written to the terminal in one go. The buffer
+ * grows by doubling and is meant to be kept: abClear empties it without
+ * giving back its memory, so once it's grown to the size of a frame,
+ * building the next frame's output doesn't allocate.
+ *
+ * b, len: The output so far.
+ * capacity: Room in b.
+ */
+struct abuf {
+  char *b;
+  size_t len;
+  size_t capacity;
+};
+
+#define ABUF_INIT {NULL, 0, 0}
+
+/**
+ * Make room for len more bytes and return where they go, or NULL if there
+ * isn't the memory. They're only part of the output once abCommit says how
+ * many of them were written.
+ */
+char *abReserve(struct abuf *ab, size_t len);
+
+/**
+ * Add len bytes, written to the span abReserve handed out, to the output.
+ */
+void abCommit(struct abuf *ab, size_t len);
+
+void abAppend(struct abuf *ab, const char *s, size_t len);
+
+/**
+ * Empty the buffer, keeping its memory.
+ */
+void abClear(struct abuf *ab);
+
+void abFree(struct abuf *ab);
+
+#endif
@@ -36,66 +36,121 @@ ScreenCursor activeCursor(Display *d) {
   int rowUnitSize = d->width / displayRowSize(d->panes->active);
   int rowOffset = rowUnitSize * ListF(Pane).length(d->panes->active->left);
   return (ScreenCursor){
-    rowOffset + activePane(d)->cursorX + 1,
+    rowOffset + activePane(d)->cursorX - activePane(d)->left + 1,
     columnOffset + activePane(d)->cursorY + 1
   };
 }
 
-List(List(List(PaneRow))) *drawDisplayColumn(DisplayColumn *column, int height, int width) {
-  int n = displayColumnSize(column);
-  int *eachHeight = malloc(sizeof(int));
-  *eachHeight = height / n;
-  int *firstHeight = malloc(sizeof(int));
-  *firstHeight = height - ((n - 1) * *eachHeight);
-  List(int) *heights =
-    ListF(int).cons(firstHeight, ListF(int).cons(eachHeight, NULL));
-  heights->tail->tail = heights->tail;
-  int *eachWidth = malloc(sizeof(int));
-  *eachWidth = width;
-  List(int) *widths = ListF(int).cons(eachWidth, NULL);
-  widths->tail = widths;
-  List(DisplayRow) *top = ListF(DisplayRow).reverse(column->up);
-  List(DisplayRow) *rows = ListF(DisplayRow).concat(
-    top,
-    ListF(DisplayRow).cons(column->active, column->down)
-  );
-  List(List(List(PaneRow))) *result = ListF4(DisplayRow, int, int, List(List(PaneRow)))
-    .zipWith(drawDisplayRow, rows, heights, widths);
+/**
+ * The ith DisplayRow of column, counting down from the top.
+ */
+static DisplayRow *displayColumnRow(DisplayColumn *column, int i) {
+  int above = ListF(DisplayRow).length(column->up);
+  if (i == above) {
+    return column->active;
+  }
+  List(DisplayRow) *rows = i < above ? column->up : column->down;
+  for (int j = i < above ? above - 1 - i : i - above - 1; j > 0; j--) {
+    rows = rows->tail;
+  }
+  return rows->head;
+}
 
-  free(heights->tail);
-  free(heights);
-  free(widths);
-  free(eachHeight);
-  free(firstHeight);
-  free(eachWidth);
-  ListF(DisplayRow).free(top);
-  ListF(DisplayRow).freeUntil(rows, column->down);
+/**
+ * The ith Pane of row, counting from the left.
+ */
+static Pane *displayRowPane(DisplayRow *row, int i) {
+  int left = ListF(Pane).length(row->left);
+  if (i == left) {
+    return row->active;
+  }
+  List(Pane) *panes = i < left ? row->left : row->right;
+  for (int j = i < left ? left - 1 - i : i - left - 1; j > 0; j--) {
+    panes = panes->tail;
+  }
+  return panes->head;
+}
 
-  return result;
+/**
+ * Make sure table has room for needed items of size bytes, doubling it
+ * until it does.
+ */
+static void *reserve(void *table, size_t *capacity, size_t needed, size_t size) {
+  if (needed <= *capacity) {
+    return table;
+  }
+  size_t newCapacity = *capacity == 0 ? 16 : *capacity;
+  while (newCapacity < needed) {
+    newCapacity *= 2;
+  }
+  *capacity = newCapacity;
+  return realloc(table, newCapacity * size);
 }
 
-List(List(PaneRow)) *drawDisplayRow(DisplayRow *row, int *height, int *width) {
-  List(Pane) *above = ListF(Pane).reverse(row->left);
-  List(Pane) *panes =
-    ListF(Pane).concat(above, ListF(Pane).cons(row->active, row->right));
-  int n = ListF(Pane).length(panes);
-  int *eachWidth = malloc(sizeof(int));
-  *eachWidth = *width / n;
-  List(int) *widths = ListF(int).cons(eachWidth, NULL);
-  widths->tail = widths;
-  List(int) *heights = ListF(int).cons(height, NULL);
-  heights->tail = heights;
-  List(List(PaneRow)) *result =
-    ListF4(Pane, int, int, List(PaneRow))
-    .zipWith(paneDraw, panes, heights, widths);
+/**
+ * Lay out row's panes side by side, over the next height lines of frame.
+ */
+static void drawDisplayRow(Frame *frame, DisplayRow *row, int height, int width) {
+  int n = displayRowSize(row);
+  int eachWidth = width / n;
+  for (int y = 0; y < height; y++) {
+    frame->lines[frame->height + y] =
+      (FrameLine){frame->rowCount + (size_t)y * n, n};
+  }
+  for (int i = 0; i < n; i++) {
+    Pane *pane = displayRowPane(row, i);
+    paneDraw(pane, height, eachWidth,
+             frame->rows + frame->rowCount + i, n,
+             frame->text + frame->textLength);
+    frame->textLength += PANE_TEXT_SIZE(height, eachWidth);
+    // the lines above the status bar
+    int64_t delta = pane->top - pane->drawnTop;
+    if (delta != 0 && delta < height - 1 && -delta < height - 1) {
+      frame->scrolls[frame->scrollCount++] =
+        (FrameScroll){frame->height, height - 1, i * eachWidth, eachWidth, (int)delta};
+    }
+    pane->drawnTop = pane->top;
+  }
+  frame->height += height;
+  frame->rowCount += (size_t)height * n;
+}
+
+void drawDisplayColumn(Frame *frame, DisplayColumn *column, int height, int width) {
+  int n = displayColumnSize(column);
+  int eachHeight = height / n;
+  int firstHeight = height - (n - 1) * eachHeight;
+  // room for every line, before any PaneRow points into the text
+  size_t rows = 0;
+  size_t text = 0;
+  size_t panes = 0;
+  for (int i = 0; i < n; i++) {
+    int rowPanes = displayRowSize(displayColumnRow(column, i));
+    int rowHeight = i == 0 ? firstHeight : eachHeight;
+    rows += (size_t)rowHeight * rowPanes;
+    text += (size_t)rowPanes * PANE_TEXT_SIZE(rowHeight, width / rowPanes);
+    panes += rowPanes;
+  }
+  frame->lines = reserve(frame->lines, &frame->lineCapacity, height, sizeof(FrameLine));
+  frame->rows = reserve(frame->rows, &frame->rowCapacity, rows, sizeof(PaneRow));
+  frame->text = reserve(frame->text, &frame->textCapacity, text, 1);
+  frame->scrolls = reserve(frame->scrolls, &frame->scrollCapacity, panes, sizeof(FrameScroll));
 
-  free(heights);
-  free(widths);
-  free(eachWidth);
-  ListF(Pane).free(above);
-  ListF(Pane).freeUntil(panes, row->right);
+  frame->height = 0;
+  frame->rowCount = 0;
+  frame->textLength = 0;
+  frame->scrollCount = 0;
+  for (int i = 0; i < n; i++) {
+    drawDisplayRow(frame, displayColumnRow(column, i),
+                   i == 0 ? firstHeight : eachHeight, width);
+  }
+}
 
-  return result;
+void freeFrame(Frame *frame) {
+  free(frame->lines);
+  free(frame->rows);
+  free(frame->text);
+  free(frame->scrolls);
+  *frame = (Frame)FRAME_INIT;
 }
 
 int displayColumnSize(DisplayColumn *column) {
@@ -1,13 +1,9 @@
 #pragma once
 
-#include "lists/DisplayRow-int-int-ListListPaneRow.h"
+#include <stddef.h>
+
 #include "lists/DisplayRow.h"
-#include "lists/ListListPaneRow.h"
-#include "lists/ListPaneRow.h"
-#include "lists/Pane-ListPaneRow.h"
-#include "lists/Pane-int-int-ListPaneRow.h"
 #include "lists/Pane.h"
-#include "lists/int.h"
 #include "pane.h"
 
 typedef struct DisplayRow DisplayRow;
@@ -45,11 +41,72 @@ int paneListSize(List(Pane) * ps);
 int columnListSize(List(DisplayRow) * ps);
 int displayColumnSize(DisplayColumn *row);
 int displayRowSize(DisplayRow *row);
-List(List(PaneRow)) * drawDisplayRow(DisplayRow *row, int *height, int *width);
 
 Pane *activePane(Display *d);
 int activeHeight(Display *d);
 int activeWidth(Display *d);
 ScreenCursor activeCursor(Display *d);
 
-List(List(List(PaneRow))) *drawDisplayColumn(DisplayColumn *column, int height, int width);
+/**
+ * One line of a frame: count PaneRows, side by side, starting at
+ * Frame.rows[start].
+ */
+typedef struct FrameLine {
+  size_t start;
+  int count;
+} FrameLine;
+
+/**
+ * A pane that's scrolled since the frame before: lines top up to top +
+ * height of the frame, from column left for width columns, show what the
+ * frame before showed delta lines further down (up, if delta is negative).
+ */
+typedef struct FrameScroll {
+  int top;
+  int height;
+  int left;
+  int width;
+  int delta;
+} FrameScroll;
+
+/**
+ * A display laid out for drawing, as a table of lines. The tables are kept
+ * from one frame to the next and only ever grow, so laying out a frame no
+ * bigger than the last one doesn't allocate anything.
+ *
+ * height: Number of lines laid out.
+ * lines: Where each line's PaneRows are.
+ * rows: The PaneRows of every line, each DisplayRow's after the one above.
+ * text: Text drawn this frame that isn't part of a row (see paneDraw),
+ *   PANE_TEXT_SIZE of each pane's height and width.
+ * scrolls: The panes that have scrolled, if they haven't scrolled further
+ *   than they are high.
+ * rowCount, textLength, scrollCount: How much of rows, text and scrolls
+ *   this frame uses.
+ * lineCapacity, rowCapacity, textCapacity, scrollCapacity: How big the
+ *   tables are.
+ */
+typedef struct Frame {
+  int height;
+  FrameLine *lines;
+  PaneRow *rows;
+  char *text;
+  FrameScroll *scrolls;
+  size_t rowCount;
+  size_t textLength;
+  size_t scrollCount;
+  size_t lineCapacity;
+  size_t rowCapacity;
+  size_t textCapacity;
+  size_t scrollCapacity;
+} Frame;
+
+#define FRAME_INIT {0, NULL, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0}
+
+/**
+ * Lay out column, height lines by width characters, into frame, replacing
+ * the frame before, and note which panes have scrolled since then.
+ */
+void drawDisplayColumn(Frame *frame, DisplayColumn *column, int height, int width);
+
+void freeFrame(Frame *frame);
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include "string.h"
 
 enum ObjectType { Character, Word, Line, Paragraph, Page, Buffer };
@@ -25,6 +26,7 @@ enum EditType
 
 struct InsertArguments {
   char *text;
+  int64_t length;
 };
 
 struct DeleteArguments {
@@ -1,56 +1,177 @@
 #include <stdlib.h>
 #include <string.h>
 #include "editorRow.h"
+#include "tabs.h"
 
-EditorRow *newRow(char *s, size_t length, int tabSize) {
-  EditorRow *row = malloc(sizeof(*row));
+/**
+ * A new row with room for textSize characters of inline text.
+ */
+static EditorRow *allocateRow(size_t length, int tabSize, size_t textSize) {
+  EditorRow *row = malloc(sizeof(*row) + textSize);
+  row->references = 0;
   row->size = length;
-  row->chars = s;
-  row->renderSize = 0;
+  row->tabSize = tabSize;
+  row->tabCount = -1;
+  row->view = false;
+  row->chars = row->text;
   row->renderChars = NULL;
-  editorUpdateRow(row, tabSize);
+  row->tabs = NULL;
   return row;
 }
 
-int editorCursorToRender(EditorRow *row, int cursorX, int tabSize) {
-  int renderX = 0;
-  for (int j = 0; j < cursorX; j++) {
-    if (row->chars[j] == '\t') {
-      renderX += tabSize;
+EditorRow *newRow(char *s, size_t length, int tabSize) {
+  EditorRow *row = allocateRow(length, tabSize, 0);
+  row->chars = s;
+  return row;
+}
+
+EditorRow *newRowCopy(const char *s, size_t length, int tabSize) {
+  EditorRow *row = allocateRow(length, tabSize, length + 1);
+  memcpy(row->text, s, length);
+  row->text[length] = '\0';
+  return row;
+}
+
+EditorRow *newRowView(const char *s, size_t length, int tabSize) {
+  EditorRow *row = allocateRow(length, tabSize, 0);
+  row->chars = (char *)s;
+  row->view = true;
+  return row;
+}
+
+/**
+ * Build the row's tab index, if it hasn't got one yet.
+ */
+static void indexTabs(EditorRow *row) {
+  if (row->tabCount >= 0) return;
+  int64_t count = countTabs(row->chars, row->size);
+  row->tabs = count == 0 ? NULL : malloc(count * sizeof(int64_t));
+  int64_t i = 0;
+  for (int64_t k = 0; k < count; k++) {
+    i += findTab(row->chars + i, row->size - i);
+    row->tabs[k] = i++;
+  }
+  row->tabCount = count;
+}
+
+/**
+ * Number of tabs before index x.
+ */
+static int64_t tabsBefore(EditorRow *row, int64_t x) {
+  int64_t low = 0;
+  int64_t high = row->tabCount;
+  while (low < high) {
+    int64_t middle = low + (high - low) / 2;
+    if (row->tabs[middle] < x) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+int64_t editorCursorToRender(EditorRow *row, int64_t cursorX, int tabSize) {
+  if (cursorX > row->size) cursorX = row->size;
+  indexTabs(row);
+  return cursorX + tabsBefore(row, cursorX) * (tabSize - 1);
+}
+
+int64_t editorRenderToCursor(EditorRow *row, int64_t renderX, int tabSize) {
+  if (renderX <= 0) return 0;
+  indexTabs(row);
+  // find the last tab that starts at or before renderX
+  int64_t low = 0;
+  int64_t high = row->tabCount;
+  while (low < high) {
+    int64_t middle = low + (high - low) / 2;
+    if (row->tabs[middle] + middle * (tabSize - 1) <= renderX) {
+      low = middle + 1;
     } else {
-      renderX += 1;
+      high = middle;
     }
   }
-  return renderX;
+  int64_t cursorX = renderX - low * (tabSize - 1);
+  if (low > 0 && renderX <= row->tabs[low - 1] + low * (tabSize - 1)) {
+    cursorX = row->tabs[low - 1];
+  }
+  return cursorX > row->size ? row->size : cursorX;
+}
+
+EditorRow *editorRowSplice(EditorRow *row, int64_t at, int64_t removed,
+                           const char *text, int64_t length) {
+  int64_t size = row->size - removed + length;
+  EditorRow *new = allocateRow(size, row->tabSize, size + 1);
+  memcpy(new->text, row->chars, at);
+  memcpy(new->text + at, text, length);
+  memcpy(new->text + at + length, row->chars + at + removed, row->size - at - removed);
+  new->text[size] = '\0';
+  if (row->tabCount < 0) return new;
+
+  int64_t before = tabsBefore(row, at);
+  int64_t after = tabsBefore(row, at + removed);
+  int64_t count = before + countTabs(text, length) + row->tabCount - after;
+  new->tabs = count == 0 ? NULL : malloc(count * sizeof(int64_t));
+  memcpy(new->tabs, row->tabs, before * sizeof(int64_t));
+  int64_t k = before;
+  for (int64_t i = findTab(text, length); i < length; i += 1 + findTab(text + i + 1, length - i - 1)) {
+    new->tabs[k++] = at + i;
+  }
+  for (int64_t j = after; j < row->tabCount; j++) {
+    new->tabs[k++] = row->tabs[j] + length - removed;
+  }
+  new->tabCount = count;
+  return new;
 }
 
 /**
  * Update the rendered characters for a row.
  */
 void editorUpdateRow(EditorRow *row, int tabSize) {
-  int tabs = 0;
-  for (int j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t') {
-      tabs++;
-    }
+  indexTabs(row);
+  int64_t tabs = row->tabCount;
+  if (row->renderChars != row->chars) {
+    free(row->renderChars);
+  }
+  row->tabSize = tabSize;
+  if (tabs == 0) {
+    row->renderChars = row->chars;
+    return;
   }
-  free(row->renderChars);
   row->renderChars = malloc(row->size + tabs * (tabSize - 1) + 1);
-  int i = 0;
-  for (int j = 0; j < row->size; j++) {
-    if (row->chars[j] == '\t') {
-      for (int size = tabSize; size > 0; size--) {
-        row->renderChars[i++] = ' ';
-      }
-    } else {
-      row->renderChars[i++] = row->chars[j];
-    }
+  size_t renderSize = expandTabs(row->chars, row->size, tabSize, row->renderChars);
+  row->renderChars[renderSize] = '\0';
+}
+
+char *editorRowRender(EditorRow *row) {
+  if (row->renderChars == NULL) {
+    editorUpdateRow(row, row->tabSize);
   }
-  row->renderChars[i] = '\0';
-  row->renderSize = i;
+  return row->renderChars;
+}
+
+int64_t editorRowRenderSize(EditorRow *row) {
+  indexTabs(row);
+  return row->size + row->tabCount * (row->tabSize - 1);
 }
 
 void editorFreeRow(EditorRow *row) {
-  free(row->renderChars);
-  free(row->chars);
+  if (row->renderChars != row->chars) {
+    free(row->renderChars);
+  }
+  if (row->chars != row->text && !row->view) {
+    free(row->chars);
+  }
+  free(row->tabs);
+}
+
+EditorRow *editorRetainRow(EditorRow *row) {
+  row->references++;
+  return row;
+}
+
+void editorReleaseRow(EditorRow *row) {
+  if (--row->references > 0) return;
+  editorFreeRow(row);
+  free(row);
 }
@@ -1,26 +1,101 @@
 #ifndef EDITOR_ROW
 #define EDITOR_ROW
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 typedef struct EditorRow EditorRow;
 
+/**
+ * A line of text. Rows are never changed once they're in a buffer: edits make
+ * new rows.
+ *
+ * Rows made by newRowCopy and editorRowSplice keep their characters in text,
+ * in the same allocation as the row, so a short row without tabs is a single
+ * allocation of a cache line or so.
+ *
+ * references: Number of row tree leaves holding the row. A new row has none;
+ *   it's freed when the last leaf holding it lets go.
+ * chars: The characters, followed by a '\0'. Either text, or a separate
+ *   allocation handed over to newRow, or (for rows made by newRowView, whose
+ *   characters aren't followed by a '\0') memory the row doesn't own.
+ * view: Whether chars belongs to something else, and isn't freed with the
+ *   row.
+ * renderChars: The row as it's drawn, with tabs expanded to tabSize spaces.
+ *   Worked out the first time it's asked for (see editorRowRender), so rows
+ *   that are never drawn never render. A row without tabs renders as itself:
+ *   renderChars is chars.
+ * tabCount, tabs: Index of where the tabs are in chars, in order, so that
+ *   converting between character and screen columns is a binary search
+ *   rather than a scan of the row. Built along with renderChars, or the
+ *   first time a column is converted, and carried over to the rows made by
+ *   editorRowSplice. tabCount is -1 until then; tabs is NULL if there are no
+ *   tabs.
+ */
 struct EditorRow {
-  int size;
+  int references;
+  int tabSize;
+  int64_t size;
+  int64_t tabCount;
+  bool view;
   char *chars;
-  int renderSize;
   char *renderChars;
+  int64_t *tabs;
+  char text[];
 };
 
+/**
+ * A new row, which takes ownership of s (it's freed along with the row).
+ */
 EditorRow *newRow(char *s, size_t length, int tabSize);
 
-int editorCursorToRender(EditorRow *row, int cursorX, int tabSize);
+/**
+ * A new row holding a copy of the first length characters of s.
+ */
+EditorRow *newRowCopy(const char *s, size_t length, int tabSize);
+
+/**
+ * A new row whose characters are the first length characters of s, without
+ * copying them. s has to outlive the row (e.g. it's in a mapped file).
+ */
+EditorRow *newRowView(const char *s, size_t length, int tabSize);
+
+int64_t editorCursorToRender(EditorRow *row, int64_t cursorX, int tabSize);
+
+/**
+ * The character at screen column renderX (relative to the start of the row).
+ * A column in the middle of a tab gives the tab.
+ */
+int64_t editorRenderToCursor(EditorRow *row, int64_t renderX, int tabSize);
+
+/**
+ * A new row made from row by replacing the removed characters starting at at
+ * with the first length characters of text. If row has a tab index, the new
+ * row gets one too, without scanning the parts the two have in common.
+ */
+EditorRow *editorRowSplice(EditorRow *row, int64_t at, int64_t removed,
+                           const char *text, int64_t length);
 
 /**
  * Update the rendered characters for a row.
  */
 void editorUpdateRow(EditorRow *row, int tabSize);
 
+/**
+ * The rendered characters of a row, rendering it first if needed.
+ */
+char *editorRowRender(EditorRow *row);
+
+int64_t editorRowRenderSize(EditorRow *row);
+
 void editorFreeRow(EditorRow *row);
 
+EditorRow *editorRetainRow(EditorRow *row);
+
+/**
+ * Give up a reference to row, freeing it if that was the last one.
+ */
+void editorReleaseRow(EditorRow *row);
+
 #endif
@@ -1,7 +1,7 @@
 #include "fileData.h"
 #include <stdlib.h>
 
-FileData *fileData(int cursorX, int cursorY, int numberOfRows,
+FileData *fileData(int64_t cursorX, int64_t cursorY, int64_t numberOfRows,
                    ZipperBuffer *buffer, char *filename, int unsavedChanges,
                    UndoStack *undo, UndoStack *redo) {
   FileData *fd = malloc(sizeof(FileData));
@@ -11,8 +11,13 @@ FileData *fileData(int cursorX, int cursorY, int numberOfRows,
   fd->buffer = buffer;
   fd->filename = filename;
   fd->unsavedChanges = unsavedChanges;
+  fd->save = NULL;
+  fd->savingChanges = 0;
   fd->undo = undo;
   fd->redo = redo;
+  fd->indexing = NULL;
+  fd->journal = NULL;
+  fd->journalAtSave = 0;
   return fd;
 }
 
@@ -48,20 +53,40 @@ void onFailure(OperationResult *result, void (*f)(const char *, ...)) {
 void editorPushRedo(
   ZipperBuffer *buffer,
   UndoStack **redo,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 ) {
-  *redo = undoCons(buffer->forwards, buffer->backwards, cursorX, cursorY, *redo);
+  zipperCloseRow(buffer);
+  *redo = undoCons(buffer->rows, buffer->rope, cursorX, cursorY, *redo);
 }
 
 void editorPushUndo(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 ) {
-  zipperUpdateNewest(buffer);
-  *undo = undoCons(buffer->forwards, buffer->backwards, cursorX, cursorY, *undo);
+  zipperCloseRow(buffer);
+  *undo = undoCons(buffer->rows, buffer->rope, cursorX, cursorY, *undo);
+}
+
+/**
+ * Switch buffer to the version of its text in entry.
+ */
+static void restoreVersion(ZipperBuffer *buffer, UndoStack *entry, int64_t cursor) {
+  if (zipperIsRope(buffer)) {
+    zipperSetRope(buffer, entry->rope, cursor);
+  } else {
+    zipperSetRows(buffer, entry->rows, cursor);
+  }
+}
+
+void editorClearRedo(FileData *file) {
+  while (file->redo != NULL) {
+    UndoStack *entry = file->redo;
+    file->redo = entry->tail;
+    undoFree(entry);
+  }
 }
 
 OperationResult *editorUndo(FileData *file) {
@@ -70,12 +95,12 @@ OperationResult *editorUndo(FileData *file) {
   }
   editorPushRedo(file->buffer, &file->redo, file->cursorX, file->cursorY);
   UndoStack *oldUndo = file->undo;
-  file->buffer->forwards = oldUndo->forwards;
-  file->buffer->backwards = oldUndo->backwards;
+  restoreVersion(file->buffer, oldUndo, oldUndo->cursorY);
   file->cursorX = oldUndo->cursorX;
   file->cursorY = oldUndo->cursorY;
+  file->numberOfRows = zipperLength(file->buffer);
   file->undo = oldUndo->tail;
-  free(oldUndo);
+  undoFree(oldUndo);
   return success();
 }
 
@@ -85,11 +110,11 @@ OperationResult *editorRedo(FileData *file) {
   }
   editorPushUndo(file->buffer, &file->undo, file->cursorX, file->cursorY);
   UndoStack *oldRedo = file->redo;
-  file->buffer->forwards = oldRedo->forwards;
-  file->buffer->backwards = oldRedo->backwards;
+  restoreVersion(file->buffer, oldRedo, oldRedo->cursorY);
   file->cursorX = oldRedo->cursorX;
   file->cursorY = oldRedo->cursorY;
+  file->numberOfRows = zipperLength(file->buffer);
   file->redo = oldRedo->tail;
-  free(oldRedo);
+  undoFree(oldRedo);
   return success();
 }
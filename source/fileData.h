@@ -1,6 +1,11 @@
 #pragma once
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include "journal.h"
+#include "mappedFile.h"
+#include "save.h"
 #include "undo.h"
 #include "zipperBuffer.h"
 
@@ -10,23 +15,38 @@
  *
  * cursorX, cursorY: Position of the cursor within the file in characters.
  *   10, 42 is the 11th line from the top, 43rd column from the left
- * numberOfRows: Number of lines in the file.
+ * numberOfRows: Number of lines in the file, or in as much of it as has
+ *   been indexed so far.
  * buffer: The underlying file buffer.
  * filename: Full path of the file.
  * unsavedChanges: How many changes have been made since the last save.
+ * save: The save running in the background, if there is one.
+ * savingChanges: What unsavedChanges was when save took its snapshot, so
+ *   that changes made while it runs are still counted as unsaved after it.
  * undo, redo: The undo and redo data for the file.
+ * indexing: The mapped file the rows come from, while its lines are still
+ *   being indexed. They're added to the rows as they are (see
+ *   editorIndexMore). NULL once they all have been.
+ * journal: Where edits are kept until they're saved, if the file has one.
+ * journalAtSave: The journal's length when save took its snapshot: the
+ *   records after it are still unsaved after the save.
  */
 typedef struct FileData {
-  int cursorX, cursorY;
-  int numberOfRows;
+  int64_t cursorX, cursorY;
+  int64_t numberOfRows;
   ZipperBuffer *buffer;
   char *filename;
   int unsavedChanges;
+  Save *save;
+  int savingChanges;
   UndoStack *undo;
   UndoStack *redo;
+  MappedFile *indexing;
+  Journal *journal;
+  size_t journalAtSave;
 } FileData;
 
-FileData *fileData(int cursorX, int cursorY, int numberOfRows,
+FileData *fileData(int64_t cursorX, int64_t cursorY, int64_t numberOfRows,
                    ZipperBuffer *buffer, char *filename, int unsavedChanges,
                    UndoStack *undo, UndoStack *redo);
 
@@ -51,17 +71,22 @@ void onFailure(OperationResult *result, void (*f)(const char *, ...));
 void editorPushRedo(
   ZipperBuffer *buffer,
   UndoStack **redo,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 );
 
 void editorPushUndo(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 );
 
+/**
+ * Drop the redo history, e.g. because a new edit has made it stale.
+ */
+void editorClearRedo(FileData *file);
+
 OperationResult *editorUndo(FileData *file);
 
 OperationResult *editorRedo(FileData *file);
@@ -0,0 +1,119 @@
+#include <stdlib.h>
+#include <string.h>
+#include "editorRow.h"
+#include "gapBuffer.h"
+#include "tabs.h"
+
+/**
+ * Room left for typing when a row is opened.
+ */
+#define GAP_MINIMUM 64
+
+GapBuffer *gapBuffer(EditorRow *row, int64_t at) {
+  if (at < 0) at = 0;
+  if (at > row->size) at = row->size;
+  GapBuffer *gap = malloc(sizeof(GapBuffer));
+  gap->capacity = row->size + GAP_MINIMUM;
+  gap->text = malloc(gap->capacity);
+  gap->gapStart = at;
+  gap->gapEnd = at + GAP_MINIMUM;
+  memcpy(gap->text, row->chars, at);
+  memcpy(gap->text + gap->gapEnd, row->chars + at, row->size - at);
+  gap->tabSize = row->tabSize;
+  gap->tabsBefore = countTabs(row->chars, at);
+  return gap;
+}
+
+void gapFree(GapBuffer *gap) {
+  free(gap->text);
+  free(gap);
+}
+
+int64_t gapLength(GapBuffer *gap) {
+  return gap->capacity - (gap->gapEnd - gap->gapStart);
+}
+
+/**
+ * The character at index i of the row.
+ */
+static char gapAt(GapBuffer *gap, int64_t i) {
+  return gap->text[i < gap->gapStart ? i : i + gap->gapEnd - gap->gapStart];
+}
+
+void gapMoveTo(GapBuffer *gap, int64_t at) {
+  if (at < 0) at = 0;
+  if (at > gapLength(gap)) at = gapLength(gap);
+  if (at < gap->gapStart) {
+    int64_t n = gap->gapStart - at;
+    gap->tabsBefore -= countTabs(gap->text + at, n);
+    memmove(gap->text + gap->gapEnd - n, gap->text + at, n);
+    gap->gapStart -= n;
+    gap->gapEnd -= n;
+  } else if (at > gap->gapStart) {
+    int64_t n = at - gap->gapStart;
+    gap->tabsBefore += countTabs(gap->text + gap->gapEnd, n);
+    memmove(gap->text + gap->gapStart, gap->text + gap->gapEnd, n);
+    gap->gapStart += n;
+    gap->gapEnd += n;
+  }
+}
+
+void gapInsert(GapBuffer *gap, char c) {
+  if (gap->gapStart == gap->gapEnd) {
+    int64_t after = gap->capacity - gap->gapEnd;
+    int64_t capacity = gap->capacity * 2 + GAP_MINIMUM;
+    gap->text = realloc(gap->text, capacity);
+    memmove(gap->text + capacity - after, gap->text + gap->gapEnd, after);
+    gap->gapEnd = capacity - after;
+    gap->capacity = capacity;
+  }
+  gap->text[gap->gapStart++] = c;
+  if (c == '\t') {
+    gap->tabsBefore++;
+  }
+}
+
+void gapDelete(GapBuffer *gap) {
+  if (gap->gapStart == 0) return;
+  if (gap->text[--gap->gapStart] == '\t') {
+    gap->tabsBefore--;
+  }
+}
+
+int64_t gapCursorToRender(GapBuffer *gap) {
+  return gap->gapStart + gap->tabsBefore * (gap->tabSize - 1);
+}
+
+static int charWidth(GapBuffer *gap, char c) {
+  return c == '\t' ? gap->tabSize : 1;
+}
+
+int gapRender(GapBuffer *gap, int64_t left, int width, char *out) {
+  int64_t length = gapLength(gap);
+  int64_t i = gap->gapStart;
+  int64_t column = gapCursorToRender(gap);
+  // find the first character that reaches column left
+  while (i > 0 && column > left) {
+    column -= charWidth(gap, gapAt(gap, --i));
+  }
+  while (i < length && column + charWidth(gap, gapAt(gap, i)) <= left) {
+    column += charWidth(gap, gapAt(gap, i++));
+  }
+  int n = 0;
+  for (; i < length && n < width; i++) {
+    char c = gapAt(gap, i);
+    int w = charWidth(gap, c);
+    for (int k = 0; k < w && n < width; k++) {
+      if (column + k >= left) {
+        out[n++] = c == '\t' ? ' ' : c;
+      }
+    }
+    column += w;
+  }
+  return n;
+}
+
+EditorRow *gapToRow(GapBuffer *gap) {
+  gapMoveTo(gap, gapLength(gap));
+  return newRowCopy(gap->text, gap->gapStart, gap->tabSize);
+}
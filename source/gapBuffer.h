@@ -0,0 +1,74 @@
+#ifndef GAP_BUFFER
+#define GAP_BUFFER
+
+#include "editorRow.h"
+
+typedef struct GapBuffer GapBuffer;
+
+/**
+ * A row being edited: its characters with a gap at the cursor, so that typing
+ * or deleting there doesn't copy the rest of the row. Moving the cursor moves
+ * the gap, by copying the characters in between.
+ *
+ * text: The characters before the gap, then capacity - gapEnd characters
+ *   after it.
+ * gapStart, gapEnd: Start and end of the gap. gapStart is also the index of
+ *   the cursor in the row.
+ * tabSize: Tab size of the row the buffer was opened from.
+ * tabsBefore: Number of tabs before the gap, so that the cursor's screen
+ *   column is known without a scan.
+ */
+struct GapBuffer {
+  char *text;
+  int64_t capacity;
+  int64_t gapStart;
+  int64_t gapEnd;
+  int tabSize;
+  int64_t tabsBefore;
+};
+
+/**
+ * A gap buffer holding the characters of row, with the gap at index at.
+ */
+GapBuffer *gapBuffer(EditorRow *row, int64_t at);
+
+void gapFree(GapBuffer *gap);
+
+/**
+ * Number of characters (not counting the gap).
+ */
+int64_t gapLength(GapBuffer *gap);
+
+/**
+ * Move the gap to index at, clipped to the row.
+ */
+void gapMoveTo(GapBuffer *gap, int64_t at);
+
+/**
+ * Insert c at the gap, growing it if it's full.
+ */
+void gapInsert(GapBuffer *gap, char c);
+
+/**
+ * Delete the character before the gap, if there is one.
+ */
+void gapDelete(GapBuffer *gap);
+
+/**
+ * Screen column of the gap (from the start of the row).
+ */
+int64_t gapCursorToRender(GapBuffer *gap);
+
+/**
+ * Write the screen columns left to left + width of the row (with tabs
+ * expanded) to out, and return how many there were. Only looks at the
+ * characters between the gap and those columns.
+ */
+int gapRender(GapBuffer *gap, int64_t left, int width, char *out);
+
+/**
+ * A new row holding the characters. Leaves the gap at the end of the row.
+ */
+EditorRow *gapToRow(GapBuffer *gap);
+
+#endif
@@ -0,0 +1,268 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "journal.h"
+
+static const char magic[8] = "KIBIJRN2";
+
+/**
+ * Record fields before the text: type, open, cursorX, cursorY, length.
+ */
+#define RECORD_SIZE (1 + 1 + 3 * 8)
+
+char *journalPath(const char *filename) {
+  const char *slash = strrchr(filename, '/');
+  int directory = slash == NULL ? 0 : slash - filename + 1;
+  char *path = malloc(strlen(filename) + 16);
+  sprintf(path, "%.*s.%s.kibi-journal", directory, filename, filename + directory);
+  return path;
+}
+
+/**
+ * The header for filename as it is now: magic, then the size and
+ * modification time (seconds and nanoseconds) of the file. Returns false if
+ * it can't be read.
+ */
+static bool header(const char *filename, char *out) {
+  struct stat status;
+  if (stat(filename, &status) == -1) return false;
+  int64_t fields[3] = {status.st_size, status.st_mtim.tv_sec, status.st_mtim.tv_nsec};
+  memcpy(out, magic, 8);
+  memcpy(out + 8, fields, sizeof(fields));
+  return true;
+}
+
+static bool writeAll(int fileDescriptor, const char *s, size_t length) {
+  while (length > 0) {
+    ssize_t written = write(fileDescriptor, s, length);
+    if (written < 0) return false;
+    s += written;
+    length -= written;
+  }
+  return true;
+}
+
+static Journal *newJournal(int fileDescriptor, char *path, size_t length) {
+  Journal *journal = malloc(sizeof(*journal));
+  journal->fileDescriptor = fileDescriptor;
+  journal->path = path;
+  journal->started = false;
+  journal->length = length;
+  journal->pending = NULL;
+  journal->pendingLength = 0;
+  journal->pendingCapacity = 0;
+  journal->pendingRecords = 0;
+  return journal;
+}
+
+/**
+ * Open the file at path for adding to, with flags, and lock it. Returns -1
+ * (with errno set to EWOULDBLOCK if another editor has it locked) if that
+ * fails.
+ */
+static int openLocked(const char *path, int flags) {
+  int fileDescriptor = open(path, O_RDWR | O_APPEND | flags, 0600);
+  if (fileDescriptor != -1 && flock(fileDescriptor, LOCK_EX | LOCK_NB) == -1) {
+    int error = errno;
+    close(fileDescriptor);
+    errno = error;
+    return -1;
+  }
+  return fileDescriptor;
+}
+
+static long millisecondsSince(struct timespec *then) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - then->tv_sec) * 1000 + (now.tv_nsec - then->tv_nsec) / 1000000;
+}
+
+Journal *journalOpen(const char *filename) {
+  char start[JOURNAL_HEADER_SIZE];
+  if (!header(filename, start)) return NULL;
+  Journal *journal = newJournal(-1, journalPath(filename), 0);
+  memcpy(journal->header, start, JOURNAL_HEADER_SIZE);
+  return journal;
+}
+
+/**
+ * Read the whole of the journal open on fileDescriptor, setting size. NULL
+ * if it can't be read.
+ */
+static char *readJournal(int fileDescriptor, size_t *size) {
+  struct stat status;
+  if (fstat(fileDescriptor, &status) == -1) return NULL;
+  char *data = malloc(status.st_size + 1);
+  size_t got = 0;
+  ssize_t n;
+  while (got < (size_t)status.st_size &&
+         (n = pread(fileDescriptor, data + got, status.st_size - got, got)) > 0) {
+    got += n;
+  }
+  *size = got;
+  return data;
+}
+
+Journal *journalRecover(const char *filename,
+                        void (*replay)(JournalRecord *record, void *context),
+                        void *context, int *count) {
+  *count = 0;
+  char *path = journalPath(filename);
+  int fileDescriptor = openLocked(path, 0);
+  if (fileDescriptor == -1) {
+    free(path);
+    return errno == EWOULDBLOCK ? NULL : journalOpen(filename);
+  }
+  Journal *journal = newJournal(fileDescriptor, path, 0);
+  size_t size;
+  char *data = readJournal(fileDescriptor, &size);
+  if (!header(filename, journal->header) || data == NULL ||
+      size < JOURNAL_HEADER_SIZE ||
+      memcmp(data, journal->header, JOURNAL_HEADER_SIZE) != 0) {
+    // left for another version: replaced once there's something to journal
+    free(data);
+    return journal;
+  }
+
+  size_t at = JOURNAL_HEADER_SIZE;
+  while (size - at >= RECORD_SIZE && (unsigned char)data[at] <= JournalRedo) {
+    int64_t fields[3];
+    memcpy(fields, data + at + 2, sizeof(fields));
+    if (fields[2] < 0 || size - at - RECORD_SIZE < (uint64_t)fields[2]) break;
+    JournalRecord record = {
+      .type = data[at],
+      .open = data[at + 1],
+      .cursorX = fields[0],
+      .cursorY = fields[1],
+      .length = fields[2],
+      .text = data + at + RECORD_SIZE
+    };
+    replay(&record, context);
+    at += RECORD_SIZE + record.length;
+    (*count)++;
+  }
+  free(data);
+
+  if (ftruncate(fileDescriptor, at) == -1) {
+    journalClose(journal, false);
+    return NULL;
+  }
+  journal->started = true;
+  journal->length = at - JOURNAL_HEADER_SIZE;
+  return journal;
+}
+
+bool journalAppend(Journal *journal, JournalRecord *record) {
+  size_t size = RECORD_SIZE + record->length;
+  if (journal->pendingLength + size > journal->pendingCapacity) {
+    journal->pendingCapacity = 2 * journal->pendingCapacity + size;
+    journal->pending = realloc(journal->pending, journal->pendingCapacity);
+  }
+  char *out = journal->pending + journal->pendingLength;
+  int64_t fields[3] = {record->cursorX, record->cursorY, record->length};
+  out[0] = record->type;
+  out[1] = record->open;
+  memcpy(out + 2, fields, sizeof(fields));
+  if (record->length > 0) memcpy(out + RECORD_SIZE, record->text, record->length);
+  journal->pendingLength += size;
+  journal->length += size;
+  if (journal->pendingRecords++ == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &journal->pendingSince);
+  }
+  if (journal->pendingRecords >= JOURNAL_COMMIT_RECORDS) {
+    return journalCommit(journal);
+  }
+  return journalTick(journal);
+}
+
+bool journalTick(Journal *journal) {
+  if (journal->pendingRecords == 0 ||
+      millisecondsSince(&journal->pendingSince) < JOURNAL_COMMIT_MILLISECONDS) {
+    return true;
+  }
+  return journalCommit(journal);
+}
+
+bool journalCommit(Journal *journal) {
+  if (journal->pendingRecords == 0) return true;
+  if (journal->fileDescriptor == -1) {
+    journal->fileDescriptor = openLocked(journal->path, O_CREAT);
+    if (journal->fileDescriptor == -1) return false;
+  }
+  if (!journal->started) {
+    if (ftruncate(journal->fileDescriptor, 0) == -1 ||
+        !writeAll(journal->fileDescriptor, journal->header, JOURNAL_HEADER_SIZE)) {
+      return false;
+    }
+    journal->started = true;
+  }
+  bool written = writeAll(journal->fileDescriptor, journal->pending, journal->pendingLength) &&
+                 fdatasync(journal->fileDescriptor) == 0;
+  journal->pendingLength = 0;
+  journal->pendingRecords = 0;
+  return written;
+}
+
+bool journalRestart(Journal *journal, const char *filename, size_t from) {
+  if (!journalCommit(journal)) return false;
+  size_t kept = journal->length - from;
+  char *records = malloc(JOURNAL_HEADER_SIZE + kept);
+  if (!header(filename, records)) {
+    free(records);
+    return false;
+  }
+  memcpy(journal->header, records, JOURNAL_HEADER_SIZE);
+  if (kept == 0) {
+    // nothing left that isn't saved
+    if (journal->fileDescriptor != -1) {
+      unlink(journal->path);
+      close(journal->fileDescriptor);
+      journal->fileDescriptor = -1;
+    }
+    journal->started = false;
+    journal->length = 0;
+    free(records);
+    return true;
+  }
+  char *temporary = malloc(strlen(journal->path) + 2);
+  sprintf(temporary, "%s~", journal->path);
+  int fileDescriptor = -1;
+  bool restarted =
+    pread(journal->fileDescriptor, records + JOURNAL_HEADER_SIZE, kept, JOURNAL_HEADER_SIZE + from) == (ssize_t)kept &&
+    (fileDescriptor = openLocked(temporary, O_CREAT | O_TRUNC)) != -1 &&
+    writeAll(fileDescriptor, records, JOURNAL_HEADER_SIZE + kept) &&
+    fdatasync(fileDescriptor) == 0 &&
+    rename(temporary, journal->path) == 0;
+  if (restarted) {
+    close(journal->fileDescriptor);
+    journal->fileDescriptor = fileDescriptor;
+    journal->started = true;
+    journal->length = kept;
+  } else if (fileDescriptor != -1) {
+    close(fileDescriptor);
+    unlink(temporary);
+  }
+  free(temporary);
+  free(records);
+  return restarted;
+}
+
+void journalClose(Journal *journal, bool discard) {
+  if (discard) {
+    if (journal->fileDescriptor != -1) unlink(journal->path);
+  } else {
+    journalCommit(journal);
+  }
+  if (journal->fileDescriptor != -1) close(journal->fileDescriptor);
+  free(journal->pending);
+  free(journal->path);
+  free(journal);
+}
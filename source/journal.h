@@ -0,0 +1,138 @@
+#ifndef JOURNAL
+#define JOURNAL
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Records gathered before they're written out and flushed to disk together.
+ */
+#define JOURNAL_COMMIT_RECORDS 64
+
+/**
+ * Longest a record waits to be written out, in milliseconds.
+ */
+#define JOURNAL_COMMIT_MILLISECONDS 200
+
+/**
+ * Bytes of the header at the start of a journal.
+ */
+#define JOURNAL_HEADER_SIZE (8 + 3 * 8)
+
+enum JournalRecordType { JournalInsert, JournalDelete, JournalUndo, JournalRedo };
+
+/**
+ * An edit, as it's kept in a journal: what was done and where the cursor was,
+ * which is enough to do it again on the same rows.
+ *
+ * open: Whether the cursor's row was open for typing (see zipperRowIsOpen),
+ *   which decides whether the edit started a new undo step.
+ * text, length: The text inserted, for JournalInsert.
+ */
+typedef struct JournalRecord {
+  enum JournalRecordType type;
+  bool open;
+  int64_t cursorX, cursorY;
+  int64_t length;
+  const char *text;
+} JournalRecord;
+
+typedef struct Journal Journal;
+
+/**
+ * The edits made to a file since it was last saved, kept next to it (in
+ * .name.kibi-journal) so that they can be made again if the editor dies
+ * before they're saved.
+ *
+ * The journal starts with a header saying which version of the file (by size
+ * and modification time) the edits apply to, followed by the records, each
+ * a few bytes of fixed fields and then the inserted text. Records are
+ * gathered in pending and written and flushed to disk in groups, once
+ * there are JOURNAL_COMMIT_RECORDS of them or the oldest has waited
+ * JOURNAL_COMMIT_MILLISECONDS, so a crash loses at most that much typing.
+ *
+ * The journal's file is only made when the first group is written, so
+ * looking at a file without editing it leaves nothing behind, and it's
+ * deleted again once a save leaves no edits unsaved. While it's open the
+ * editor holds a lock on it (flock), so that another editor opening the same
+ * file leaves it alone rather than replacing it.
+ *
+ * fileDescriptor: The journal's file, locked, or -1 if it hasn't been made.
+ * header: The header for the version of the file the records apply to.
+ * started: Whether the file holds header (rather than one for some other
+ *   version, left behind by an editor that died).
+ * length: Bytes of records in the journal, including pending ones.
+ * pendingSince: When the oldest pending record was added.
+ */
+struct Journal {
+  int fileDescriptor;
+  char *path;
+  char header[JOURNAL_HEADER_SIZE];
+  bool started;
+  size_t length;
+  char *pending;
+  size_t pendingLength;
+  size_t pendingCapacity;
+  int pendingRecords;
+  struct timespec pendingSince;
+};
+
+/**
+ * The path of filename's journal.
+ */
+char *journalPath(const char *filename);
+
+/**
+ * Start a journal for filename, which replaces any it had once the first
+ * record is written. Returns NULL if filename can't be found.
+ */
+Journal *journalOpen(const char *filename);
+
+/**
+ * Open the journal left behind for filename, calling replay with each of its
+ * records in order, and carry on adding to it. A record cut short by a crash
+ * is dropped. Sets count to the number of records replayed. If there's no
+ * journal, or it's for a different version of the file, starts afresh (as
+ * journalOpen) with a count of 0. Returns NULL, with errno set to
+ * EWOULDBLOCK, if another editor has the journal open.
+ */
+Journal *journalRecover(const char *filename,
+                        void (*replay)(JournalRecord *record, void *context),
+                        void *context, int *count);
+
+/**
+ * Add record to the journal, committing the pending records if there are
+ * enough of them or they've waited long enough. Returns false (with errno
+ * set) if that fails, e.g. with EWOULDBLOCK if another editor has started a
+ * journal for the file since this one was opened.
+ */
+bool journalAppend(Journal *journal, JournalRecord *record);
+
+/**
+ * Commit the pending records if the oldest has waited long enough, for when
+ * the editor is idle.
+ */
+bool journalTick(Journal *journal);
+
+/**
+ * Write out the pending records and flush them to disk, making the
+ * journal's file first if it hasn't been.
+ */
+bool journalCommit(Journal *journal);
+
+/**
+ * After filename has been saved, start the journal afresh for the new
+ * version, keeping the records from offset from on (which weren't in what
+ * was saved). from is a journal length from before the save. If that
+ * leaves no records, the journal's file is deleted until the next one.
+ */
+bool journalRestart(Journal *journal, const char *filename, size_t from);
+
+/**
+ * Close the journal, committing it, or deleting it if discard is set.
+ */
+void journalClose(Journal *journal, bool discard);
+
+#endif
@@ -11,17 +11,28 @@
 #include <termios.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <string.h>
 #include <sys/types.h>
 #include <time.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <poll.h>
 
+#include "appendBuffer.h"
 #include "display.h"
 #include "edit.h"
 #include "editorRow.h"
 #include "fileData.h"
+#include "journal.h"
+#include "lineCache.h"
+#include "lines.h"
+#include "mappedFile.h"
 #include "pane.h"
+#include "rope.h"
+#include "rowTree.h"
+#include "save.h"
+#include "screen.h"
 #include "undo.h"
 #include "zipperBuffer.h"
 
@@ -33,6 +44,12 @@
 #define KIBI_VERSION "0.0.1"
 #define tabSize 4
 
+/**
+ * Seconds between passes packing the rows that haven't been used since the
+ * last one (see rowTreePack).
+ */
+#define PACK_SECONDS 10
+
 enum EditorKey {
   BACKSPACE = 127,
   ARROW_LEFT = 1000,
@@ -43,15 +60,21 @@ enum EditorKey {
   PAGE_DOWN,
   HOME_KEY,
   END_KEY,
-  DELETE_KEY
+  DELETE_KEY,
+  SAVE_FINISHED,
+  LINES_INDEXED
 };
 
 /*** data ***/
 
 typedef struct EditorConfig {
   Display display;
+  Frame frame;
+  Screen screen;
+  struct abuf output;
   char statusMessage[80];
   time_t statusMessageTime;
+  time_t packedAt;
   struct termios original_termios;
   void (*log)(char *format, ...);
   FILE *logFile;
@@ -61,10 +84,21 @@ EditorConfig editor;
 
 /*** prototypes ***/
 
-void editorForwardLine();
+void editorForwardLine(ZipperBuffer *buffer, int64_t *cursorY);
 
 void editorSetStatusMessage(const char *format, ...);
 
+bool editorPollSave(FileData *file);
+
+void editorJournal(FileData *file, enum JournalRecordType type, const char *text,
+                   int64_t length);
+
+void editorDropJournal(FileData *file);
+
+void editorIndexMore(FileData *file);
+void editorGoToLine(FileData *file, int64_t line);
+void editorPackRows(FileData *file);
+
 /*** logging ***/
 
 void stderrLog(char *format, ...) {
@@ -87,6 +121,32 @@ void noLog(char *format, ...) {
   return;
 }
 
+/**
+ * Log a navigation, without building its description when logging is off.
+ */
+void editorLogNavigation(struct Navigation n) {
+  if (editor.log == noLog) return;
+  struct String s = navigationToString(n);
+  editor.log(s.s);
+  free(s.s);
+}
+
+/**
+ * Log an edit about to be made at file's cursor, and add it to the file's
+ * journal.
+ */
+void editorLogEdit(FileData *file, struct Edit e) {
+  if (e.type == InsertText) {
+    editorJournal(file, JournalInsert, e.insert.text, e.insert.length);
+  } else {
+    editorJournal(file, JournalDelete, NULL, 0);
+  }
+  if (editor.log == noLog) return;
+  struct String s = editToString(e);
+  editor.log(s.s);
+  free(s.s);
+}
+
 /*** terminal ***/
 
 void die(const char *s) {
@@ -121,11 +181,39 @@ void enableRawMode() {
   }
 }
 
+/**
+ * Whether there's input waiting to be read.
+ */
+bool editorInputWaiting() {
+  struct pollfd input = {.fd = STDIN_FILENO, .events = POLLIN};
+  return poll(&input, 1, 0) > 0;
+}
+
+/**
+ * Do what's left to do for file while there's no input: flush its journal if
+ * it's due, and report its save if that's finished. Returns whether it was.
+ */
+bool editorIdle(FileData *file) {
+  if (file->journal != NULL && !journalTick(file->journal)) editorDropJournal(file);
+  return editorPollSave(file);
+}
+
 int editorReadKey() {
   int nread;
   char c;
+  FileData *file = activePane(&editor.display)->file;
+  if (file->indexing != NULL && !editorInputWaiting()) {
+    if (editorIdle(file)) return SAVE_FINISHED;
+    // a save reads the index, so it mustn't grow until the save's finished
+    if (file->save == NULL) {
+      editorIndexMore(file);
+      return LINES_INDEXED;
+    }
+  }
   while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
     if (nread == -1 && errno != EAGAIN) die("Error while reading input");
+    if (editorIdle(file)) return SAVE_FINISHED;
+    editorPackRows(file);
   }
   if (c == '\x1b') {
     char seq[3];
@@ -204,6 +292,26 @@ void editorUndoSteps(UndoStack *undo) {
   editorSetStatusMessage("%d undo steps.", n);
 }
 
+/*** packing ***/
+
+/**
+ * Pack file's cold rows, once every PACK_SECONDS, unless it's being saved.
+ */
+void editorPackRows(FileData *file) {
+  time_t now = time(NULL);
+  if (now - editor.packedAt < PACK_SECONDS || file->save != NULL) return;
+  zipperCloseRow(file->buffer);
+  rowTreePack(file->buffer->rows, 1);
+  editor.packedAt = now;
+}
+
+void editorPackStats() {
+  RowTreeStats stats = rowTreeStats();
+  editorSetStatusMessage("Packed %.1fMB into %.1fMB; %ld misses in %ld reads (%.1fms)",
+                         stats.rowBytes / 1e6, stats.packedBytes / 1e6, stats.unpacks,
+                         stats.reads, stats.unpackSeconds * 1e3);
+}
+
 /*** row operations ***/
 
 void editorInsertRow(
@@ -211,189 +319,120 @@ void editorInsertRow(
   size_t length,
   bool pushUndo,
   ZipperBuffer *buffer,
-  int *numberOfRows,
+  int64_t *numberOfRows,
   int *unsavedChanges,
   UndoStack **undo,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 ) {
   if (pushUndo) {
     editorPushUndo(buffer, undo, cursorX, cursorY);
   }
-  zipperInsertRow(buffer, newRow(s, length, tabSize));
+  zipperInsertRow(buffer, newRowCopy(s, length, tabSize));
   *numberOfRows = *numberOfRows + 1;
   *unsavedChanges = *unsavedChanges + 1;
 }
 
-void editorInsertRowAfter(
-  char *s,
-  size_t length,
-  bool pushUndo,
-  ZipperBuffer *buffer,
-  int *numberOfRows,
-  int *unsavedChanges,
-  UndoStack **undo,
-  int cursorX,
-  int *cursorY
-) {
-  if (pushUndo) {
-    editorPushUndo(buffer, undo, cursorX, *cursorY);
-  }
-  editorForwardLine();
-  editorInsertRow(s, length, false, buffer, numberOfRows, unsavedChanges, undo, cursorX, *cursorY);
-  if (*cursorY < activeHeight(&editor.display) - 1) {
-    *cursorY = *cursorY + 1;
-  }
-}
-
 void editorAppendRow(
   char *s,
   size_t length,
   bool pushUndo,
   ZipperBuffer *buffer,
-  int *numberOfRows,
+  int64_t *numberOfRows,
   int *unsavedChanges,
   UndoStack **undo,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 ) {
-  int i = 0;
-  while (buffer->forwards != NULL) {
-    zipperForwardRow(buffer);
-    i++;
-  }
-  editorInsertRow(s, length, pushUndo, buffer, numberOfRows, unsavedChanges, undo, cursorX, cursorY);
-  while (i > 0) {
-    zipperBackwardRow(buffer);
-    i--;
+  if (pushUndo) {
+    editorPushUndo(buffer, undo, cursorX, cursorY);
   }
+  zipperAppendRow(buffer, newRowCopy(s, length, tabSize));
+  *numberOfRows = *numberOfRows + 1;
+  *unsavedChanges = *unsavedChanges + 1;
 }
 
-void editorDeleteBetween(int startRow, int startColumn, int endRow, int endColumn) {
+void editorDeleteBetween(int64_t startRow, int64_t startColumn, int64_t endRow, int64_t endColumn) {
 
 }
 
 void editorDeleteCurrentRow(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int *numberOfRows,
+  int64_t *numberOfRows,
   int *unsavedChanges,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 ) {
-  if (buffer->forwards == NULL) return;
+  if (zipperCurrentRow(buffer) == NULL) return;
   editorPushUndo(buffer, undo, cursorX, cursorY);
-  buffer->forwards = buffer->forwards->tail;
-  numberOfRows--;
-  unsavedChanges++;
+  zipperDeleteRow(buffer, buffer->cursor);
+  *numberOfRows = *numberOfRows - 1;
+  *unsavedChanges = *unsavedChanges + 1;
 }
 
 void editorDeleteRow(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int at,
-  int *numberOfRows,
+  int64_t at,
+  int64_t *numberOfRows,
   int *unsavedChanges,
-  int cursorX,
-  int cursorY
+  int64_t cursorX,
+  int64_t cursorY
 ) {
   if (at < 0 || at >= *numberOfRows) {
     return;
   }
-  int moves = 0;
-  while (buffer->backwards != NULL) {
-    zipperBackwardRow(buffer);
-    moves--;
-  }
-  moves += at;
-  while (at > 0) {
-    zipperForwardRow(buffer);
-    at--;
-  }
-  editorDeleteCurrentRow(buffer, undo, numberOfRows, unsavedChanges, cursorX, cursorY);
-  while (moves < -1) {
-    zipperForwardRow(buffer);
-    moves++;
-  }
-  while (moves > 0) {
-    zipperBackwardRow(buffer);
-  }
-}
-
-EditorRow *editorRowInsertChar(EditorRow *row, int at, int c) {
-  if (at < 0 || at > row->size) at = row->size;
-  char *newChars = malloc(row->size + 2);
-  memcpy(newChars, row->chars, at);
-  memcpy(&newChars[at + 1], &row->chars[at], row->size - at);
-  newChars[at] = c;
-  newChars[row->size + 1] = '\0';
-  return newRow(newChars, row->size + 1, tabSize);
+  editorPushUndo(buffer, undo, cursorX, cursorY);
+  zipperDeleteRow(buffer, at);
+  *numberOfRows = *numberOfRows - 1;
+  *unsavedChanges = *unsavedChanges + 1;
 }
 
 EditorRow *editorRowAppendString(EditorRow *row, char *s, size_t length) {
-  char *newChars = malloc(row->size + length + 1);
-  memcpy(newChars, row->chars, row->size);
-  memcpy(&newChars[row->size], s, length);
-  newChars[row->size + length] = '\0';
-  return newRow(newChars, row->size + length, tabSize);
-}
-
-EditorRow *editorRowDeleteChar(EditorRow *row, int at) {
-  if (at < 0 || at >= row->size) return row;
-  char *newChars = malloc(row->size);
-  memcpy(newChars, row->chars, at);
-  memcpy(&newChars[at], &row->chars[at + 1], row->size - at);
-  newChars[row->size - 1] = '\0';
-  return newRow(newChars, row->size - 1, tabSize);
+  return editorRowSplice(row, row->size, 0, s, length);
 }
 
 /**
  * Create a new row with the first n characters of row.
  */
-EditorRow *editorRowTake(EditorRow *row, unsigned int n) {
-  char *newChars = malloc(n + 1);
-  memcpy(newChars, row->chars, n);
-  newChars[n] = '\0';
-  return newRow(newChars, n, tabSize);
+EditorRow *editorRowTake(EditorRow *row, int64_t n) {
+  return editorRowSplice(row, n, row->size - n, "", 0);
 }
 
 /**
  * Create a new row with all characters of row after the first n.
  */
-EditorRow *editorRowDrop(EditorRow *row, unsigned int n) {
-  char *newChars = malloc(row->size - n + 1);
-  memcpy(newChars, &row->chars[n], row->size - n);
-  newChars[row->size - n] = '\0';
-  return newRow(newChars, row->size - n, tabSize);
+EditorRow *editorRowDrop(EditorRow *row, int64_t n) {
+  return editorRowSplice(row, 0, n, "", 0);
 }
 
 /**
- * Split a row at an index, return a RowList of the two new rows.
+ * Split a row at an index into two new rows.
  */
-RowList *editorRowSplit(EditorRow *row, unsigned int at) {
-  EditorRow *first = editorRowTake(row, at);
-  EditorRow *second = editorRowDrop(row, at);
-  return rowListCons(first, rowListCons(second, NULL));
+void editorRowSplit(EditorRow *row, int64_t at, EditorRow **first, EditorRow **second) {
+  *first = editorRowTake(row, at);
+  *second = editorRowDrop(row, at);
 }
 
 EditorRow *editorCurrentRow(ZipperBuffer *buffer) {
-  return buffer->forwards ? buffer->forwards->head : NULL;
+  return zipperCurrentRow(buffer);
 }
 
 EditorRow *editorPreviousRow(ZipperBuffer *buffer) {
-  return buffer->backwards ? buffer->backwards->head : NULL;
+  return zipperPreviousRow(buffer);
 }
 
 /*** editor operations ***/
 
-void editorForwardLine(ZipperBuffer *buffer, int *cursorY) {
-  if (editorCurrentRow(buffer) != NULL) {
+void editorForwardLine(ZipperBuffer *buffer, int64_t *cursorY) {
+  if (zipperCurrentLength(buffer) >= 0) {
     *cursorY += 1;
     zipperForwardRow(buffer);
   }
 }
 
-void editorBackwardLine(ZipperBuffer *buffer, int *cursorY) {
+void editorBackwardLine(ZipperBuffer *buffer, int64_t *cursorY) {
   if (editorPreviousRow(buffer) != NULL) {
     *cursorY -= 1;
     zipperBackwardRow(buffer);
@@ -406,19 +445,14 @@ void editorBackwardLine(ZipperBuffer *buffer, int *cursorY) {
 void editorReplaceRow(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int cursorX,
-  int cursorY,
+  int64_t cursorX,
+  int64_t cursorY,
   int *unsavedChanges,
   EditorRow *row
 ) {
   if (row == NULL) return;
   editorPushUndo(buffer, undo, cursorX, cursorY);
-  RowList *old = buffer->forwards;
-  if (old == NULL) {
-    buffer->forwards = rowListCons(row, NULL);
-  } else {
-    buffer->forwards = rowListCons(row, old->tail);
-  }
+  zipperReplaceRow(buffer, row);
   *unsavedChanges = *unsavedChanges + 1;
 }
 
@@ -426,52 +460,44 @@ void editorInsertChar(
   int c,
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int *numberOfRows,
+  int64_t *numberOfRows,
   int *unsavedChanges,
-  int *cursorX,
-  int cursorY
+  int64_t *cursorX,
+  int64_t cursorY
 ) {
-  EditorRow *row = editorCurrentRow(buffer);
-  if (row == NULL) {
-    editorInsertRow("", 0, true, buffer, numberOfRows, unsavedChanges, undo, *cursorX, cursorY);
-    row = editorCurrentRow(buffer);
+  // a run of typing on one row is a single undo step
+  if (!zipperRowIsOpen(buffer)) {
+    if (editorCurrentRow(buffer) == NULL) {
+      editorInsertRow("", 0, true, buffer, numberOfRows, unsavedChanges, undo, *cursorX, cursorY);
+    } else {
+      editorPushUndo(buffer, undo, *cursorX, cursorY);
+    }
   }
-  EditorRow *new = editorRowInsertChar(row, *cursorX, c);
-  editorReplaceRow(buffer, undo, *cursorX, cursorY, unsavedChanges, new);
+  zipperInsertChar(buffer, *cursorX, c);
+  *unsavedChanges = *unsavedChanges + 1;
   *cursorX = *cursorX + 1;
 }
 
-void editorInsertRows(ZipperBuffer *buffer, UndoStack **undo, int cursorX, int cursorY, RowList *new, int *unsavedChanges) {
-  if (new == NULL) return;
-  editorPushUndo(buffer, undo, cursorX, cursorY);
-  RowList *end = new;
-  int added = 1;
-  while (end->tail != NULL) {
-    end = end->tail;
-    added++;
-  }
-  end->tail = buffer->forwards;
-  buffer->forwards = new;
-  *unsavedChanges += added;
-}
-
 void editorInsertNewline(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int *cursorX,
-  int *cursorY,
-  int *numberOfRows,
+  int64_t *cursorX,
+  int64_t *cursorY,
+  int64_t *numberOfRows,
   int *unsavedChanges
 ) {
   EditorRow *row = editorCurrentRow(buffer);
   if (*cursorX == 0 || row == NULL) {
-    editorInsertRowAfter("", 0, true, buffer, numberOfRows, unsavedChanges, undo, *cursorX, cursorY);
+    editorInsertRow("", 0, true, buffer, numberOfRows, unsavedChanges, undo, *cursorX, *cursorY);
+    editorForwardLine(buffer, cursorY);
   } else {
-    RowList *new = editorRowSplit(row, *cursorX);
-    editorDeleteCurrentRow(buffer, undo, numberOfRows, unsavedChanges, *cursorX, *cursorY);
-    editorInsertRows(buffer, undo, *cursorX, *cursorY, new, unsavedChanges);
-
+    EditorRow *first;
+    EditorRow *second;
+    editorRowSplit(row, *cursorX, &first, &second);
+    editorReplaceRow(buffer, undo, *cursorX, *cursorY, unsavedChanges, first);
     editorForwardLine(buffer, cursorY);
+    zipperInsertRow(buffer, second);
+    *numberOfRows = *numberOfRows + 1;
     *cursorX = 0;
   }
 }
@@ -479,18 +505,25 @@ void editorInsertNewline(
 void editorDeleteChar(
   ZipperBuffer *buffer,
   UndoStack **undo,
-  int *cursorX,
-  int *cursorY,
+  int64_t *cursorX,
+  int64_t *cursorY,
   int *unsavedChanges,
-  int *numberOfRows
+  int64_t *numberOfRows
 ) {
+  if (*cursorX > 0 && zipperRowIsOpen(buffer)) {
+    zipperDeleteChar(buffer, *cursorX);
+    *unsavedChanges = *unsavedChanges + 1;
+    *cursorX -= 1;
+    return;
+  }
   EditorRow *current = editorCurrentRow(buffer);
   if (current == NULL) return;
   EditorRow *previous = editorPreviousRow(buffer);
   if (previous == NULL && *cursorX == 0) return;
   if (*cursorX > 0) {
-    EditorRow *new = editorRowDeleteChar(current, *cursorX - 1);
-    editorReplaceRow(buffer, undo, *cursorX, *cursorY, unsavedChanges, new);
+    editorPushUndo(buffer, undo, *cursorX, *cursorY);
+    zipperDeleteChar(buffer, *cursorX);
+    *unsavedChanges = *unsavedChanges + 1;
     *cursorX -= 1;
   } else {
     *cursorX = previous->size;
@@ -505,130 +538,306 @@ void editorDeleteChar(
 
 void editorJumpToEnd(
   ZipperBuffer *buffer,
-  int *cursorY
+  int64_t *cursorY
 ) {
-  while (editorCurrentRow(buffer) != NULL) {
-    editorForwardLine(buffer, cursorY);
+  zipperJumpTo(buffer, zipperLength(buffer));
+  *cursorY = buffer->cursor;
+}
+
+/**
+ * Move the cursor to a line (clipped to the buffer), keeping it within the
+ * line's length.
+ */
+void editorJumpToLine(
+  ZipperBuffer *buffer,
+  int64_t *cursorX,
+  int64_t *cursorY,
+  int64_t line
+) {
+  zipperJumpTo(buffer, line);
+  *cursorY = buffer->cursor;
+  int64_t rowLength = zipperCurrentLength(buffer);
+  if (rowLength < 0) rowLength = 0;
+  if (*cursorX > rowLength) {
+    *cursorX = rowLength;
   }
 }
 
 void editorJumpToStart(
   ZipperBuffer *buffer,
-  int *cursorY
+  int64_t *cursorY
 ) {
-  while (editorPreviousRow(buffer) != NULL) {
-    editorBackwardLine(buffer, cursorY);
-  }
+  zipperJumpTo(buffer, 0);
+  *cursorY = buffer->cursor;
 }
 
 /*** file i/o ***/
 
-char *editorRowsToString(ZipperBuffer *editorBuffer, int *bufferLength) {
-  int rowsToEnd = 0;
-  while (editorBuffer->forwards != NULL) {
-    zipperForwardRow(editorBuffer);
-    rowsToEnd++;
-  }
-  int totalLength = 0;
-  while (editorBuffer->backwards != NULL) {
-    totalLength += editorBuffer->backwards->head->size + 1;
-    zipperBackwardRow(editorBuffer);
-  }
-  *bufferLength = totalLength;
-
-  char *buffer = malloc(totalLength);
-  char *p = buffer;
-  while (editorBuffer->forwards != NULL) {
-    memcpy(p, editorBuffer->forwards->head->chars,
-           editorBuffer->forwards->head->size);
-    p += editorBuffer->forwards->head->size;
-    *p = '\n';
-    p++;
-    zipperForwardRow(editorBuffer);
+/**
+ * The text of the file open on fileDescriptor as a rope, for a buffer that
+ * keeps its text in one. A file that can be mapped is viewed where it is, so
+ * opening it copies nothing and indexes nothing; anything else is read in
+ * blocks. A newline is added if the last line hasn't got one, as it would be
+ * when the file's saved from rows.
+ */
+Rope *editorReadRope(int fileDescriptor) {
+  Rope *rope = NULL;
+  MappedFile *file = mappedFile(fileDescriptor, tabSize);
+  if (file != NULL) {
+    rope = ropeFromMappedFile(file);
+    mappedFileRelease(file);
+  } else {
+    char block[1 << 16];
+    ssize_t got;
+    while ((got = read(fileDescriptor, block, sizeof(block))) > 0) {
+      Rope *longer = ropeInsert(rope, ropeLength(rope), block, got);
+      ropeRelease(rope);
+      rope = longer;
+    }
   }
-  while (rowsToEnd > 0) {
-    zipperBackwardRow(editorBuffer);
-    rowsToEnd--;
+  if (ropeLength(rope) > 0 && ropeIndex(rope, ropeLength(rope) - 1) != '\n') {
+    Rope *ended = ropeInsert(rope, ropeLength(rope), "\n", 1);
+    ropeRelease(rope);
+    rope = ended;
   }
-  return buffer;
+  return rope;
 }
 
+/**
+ * Open a file. If the buffer keeps its text in a rope, the file is read into
+ * one (see editorReadRope). Otherwise, if it can be mapped, its rows point into the mapping and are
+ * only made when they're first looked at. Only the first chunk of it is
+ * indexed to start with; if there's more, indexing is set to the file, and the
+ * rest is indexed a chunk at a time while the editor waits for input (see
+ * editorIndexMore), unless its index was cached the last time it was opened
+ * (see lineCache.h), in which case cursorX and cursorY are set to where the
+ * cursor was left. Otherwise (e.g. it's a pipe) it's read in blocks.
+ */
 void editorOpen(
   char *filename,
   char **editorFilename,
   ZipperBuffer *buffer,
-  UndoStack **undo,
   int *unsavedChanges,
-  int *numberOfRows,
-  int cursorX,
-  int cursorY
+  int64_t *numberOfRows,
+  MappedFile **indexing,
+  int64_t *cursorX,
+  int64_t *cursorY
 ) {
   free(*editorFilename);
   *editorFilename = strdup(filename);
-  FILE *fp = fopen(filename, "r");
-  if (!fp) die("Couldn't open file");
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t lineLength;
-  while ((lineLength = getline(&line, &linecap, fp)) != -1) {
-    while (lineLength > 0 &&
-           (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
-      lineLength--;
+  int fileDescriptor = open(filename, O_RDONLY);
+  if (fileDescriptor == -1) die("Couldn't open file");
+  *unsavedChanges = 0;
+  if (zipperIsRope(buffer)) {
+    Rope *rope = editorReadRope(fileDescriptor);
+    close(fileDescriptor);
+    zipperSetRope(buffer, rope, 0);
+    *numberOfRows = zipperLength(buffer);
+    ropeRelease(rope);
+    return;
+  }
+  MappedFile *file = mappedFile(fileDescriptor, tabSize);
+  RowTree *tree;
+  if (file != NULL) {
+    if (!mappedFileIndexed(file)) lineCacheLoad(filename, file, cursorX, cursorY);
+    tree = rowTreeFromMappedFile(file);
+    if (mappedFileIndexed(file)) {
+      mappedFileRelease(file);
+    } else {
+      *indexing = file;
     }
-    char *rowChars = malloc(lineLength + 1);
-    memcpy(rowChars, line, lineLength);
-    rowChars[lineLength] = '\0';
-    editorInsertRow(rowChars, lineLength, false, buffer, numberOfRows, unsavedChanges, undo, cursorX, cursorY);
+  } else {
+    int64_t rowCount;
+    EditorRow **rows = readLines(fileDescriptor, tabSize, &rowCount);
+    tree = rowTreeFromArray(rows, rowCount);
+    free(rows);
   }
-  buffer->forwards = rowListReverse(buffer->forwards);
-  free(line);
-  fclose(fp);
-  *unsavedChanges = 0;
+  close(fileDescriptor);
+  zipperSetRows(buffer, tree, 0);
+  *numberOfRows = rowTreeLength(tree);
+  rowTreeRelease(tree);
 }
 
-void editorSave(ZipperBuffer *editorBuffer, char *filename, int *unsavedChanges) {
-  if (filename == NULL) return;
-  int length;
-  char *buffer = editorRowsToString(editorBuffer, &length);
-  int fileDescriptor = open(filename, O_RDWR | O_CREAT, 0644);
-  if (fileDescriptor != -1) {
-    if (ftruncate(fileDescriptor, length) != -1) {
-      if (write(fileDescriptor, buffer, length) == length) {
-        close(fileDescriptor);
-        free(buffer);
-        editorSetStatusMessage("%d bytes written to disk", length);
-        *unsavedChanges = 0;
-        return;
-      }
+/**
+ * Wait for file's background save, if it has one, and report how it went.
+ */
+void editorFinishSave(FileData *file) {
+  if (file->save == NULL) return;
+  size_t length;
+  if (saveWait(file->save, &length)) {
+    editorSetStatusMessage("%zu bytes written to disk", length);
+    file->unsavedChanges -= file->savingChanges;
+    if (file->journal != NULL &&
+        !journalRestart(file->journal, file->filename, file->journalAtSave)) {
+      editorDropJournal(file);
     }
-    close(fileDescriptor);
+  } else {
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
   }
-  free(buffer);
-  editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+  file->save = NULL;
 }
 
-/*** append buffer ***/
+/**
+ * Report file's background save if it's finished. Returns whether it had.
+ */
+bool editorPollSave(FileData *file) {
+  if (file->save == NULL || !saveFinished(file->save)) return false;
+  editorFinishSave(file);
+  return true;
+}
 
-struct abuf {
-  char *b;
-  int len;
-};
+/**
+ * Start saving file in the background, from a snapshot of its rows, so that
+ * editing can carry on while it's written. A save that's still running is
+ * waited for first, so saves finish in order. If the file is still being
+ * indexed, the save writes the lines that haven't been indexed yet straight
+ * from the mapping, after the rows, rather than waiting for them.
+ */
+void editorSave(FileData *file) {
+  if (file->filename == NULL) return;
+  editorFinishSave(file);
+  zipperCloseRow(file->buffer);
+  MappedFile *rest = file->indexing;
+  if (zipperIsRope(file->buffer)) {
+    file->save = saveRopeInBackground(file->filename, file->buffer->rope);
+  } else {
+    file->save = saveInBackground(file->filename, file->buffer->rows, rest,
+                                  rest == NULL ? 0 : rest->indexed);
+  }
+  file->savingChanges = file->unsavedChanges;
+  file->journalAtSave = file->journal == NULL ? 0 : file->journal->length;
+  editorSetStatusMessage("Saving %s...", file->filename);
+}
 
-#define ABUF_INIT {NULL, 0}
+/**
+ * Index the next chunk of file's lines, and add them after its rows: in
+ * every version of them, so that undoing an edit made before they were
+ * indexed doesn't lose them. Once they've all been indexed, the index is
+ * cached for the next time the file is opened. A save that's running is
+ * waited for first, since the index can't grow while it's read.
+ */
+void editorIndexMore(FileData *file) {
+  editorFinishSave(file);
+  MappedFile *source = file->indexing;
+  int64_t from = source->count;
+  mappedFileIndex(source, mappedFileIndexChunk());
+  zipperAppendLines(file->buffer, source, from, source->count);
+  undoAppendLines(file->undo, source, from, source->count);
+  undoAppendLines(file->redo, source, from, source->count);
+  file->numberOfRows += source->count - from;
+  if (mappedFileIndexed(source)) {
+    lineCacheStore(file->filename, source, file->cursorX, file->cursorY);
+    mappedFileRelease(source);
+    file->indexing = NULL;
+  }
+}
 
-void abAppend(struct abuf *ab, const char *s, int len) {
-  char *new = realloc(ab->b, ab->len + len);
+/**
+ * Move file's cursor to a line, indexing as far as it first if need be.
+ */
+void editorGoToLine(FileData *file, int64_t line) {
+  while (file->indexing != NULL && line >= file->numberOfRows) {
+    editorIndexMore(file);
+  }
+  editorJumpToLine(file->buffer, &file->cursorX, &file->cursorY, line);
+}
+
+/**
+ * Remember where file's cursor is for the next time it's opened, along with
+ * as much of the index as has been built if it's still being indexed.
+ */
+void editorStoreCursor(FileData *file) {
+  if (file->filename == NULL) return;
+  if (file->indexing != NULL) {
+    lineCacheStore(file->filename, file->indexing, file->cursorX, file->cursorY);
+  } else {
+    lineCacheStoreCursor(file->filename, file->cursorX, file->cursorY);
+  }
+}
+
+/*** journal ***/
+
+/**
+ * Stop journalling file, e.g. because the journal can't be written.
+ */
+void editorDropJournal(FileData *file) {
+  if (errno == EWOULDBLOCK) {
+    editorSetStatusMessage("Another kibi is journalling %s: edits here won't be", file->filename);
+  } else {
+    editorSetStatusMessage("Can't write the journal! I/O error: %s", strerror(errno));
+  }
+  journalClose(file->journal, false);
+  file->journal = NULL;
+}
+
+/**
+ * Add an edit about to be made at file's cursor to its journal, with the
+ * length bytes of text it inserts.
+ */
+void editorJournal(FileData *file, enum JournalRecordType type, const char *text,
+                   int64_t length) {
+  if (file->journal == NULL) return;
+  JournalRecord record = {
+    .type = type,
+    .open = zipperRowIsOpen(file->buffer),
+    .cursorX = file->cursorX,
+    .cursorY = file->cursorY,
+    .length = length,
+    .text = text
+  };
+  if (!journalAppend(file->journal, &record)) editorDropJournal(file);
+}
 
-  if (new == NULL) {
+/**
+ * Make a journalled edit again, the same way it was made the first time
+ * (so that it's undone in the same steps).
+ */
+void editorReplay(JournalRecord *record, void *context) {
+  FileData *file = context;
+  UndoStack *undo = file->undo;
+  if (record->cursorY != file->cursorY) editorGoToLine(file, record->cursorY);
+  if (!record->open) zipperCloseRow(file->buffer);
+  file->cursorX = record->cursorX;
+  switch (record->type) {
+  case JournalInsert:
+    for (int64_t i = 0; i < record->length; i++) {
+      if (record->text[i] == '\n') {
+        editorInsertNewline(file->buffer, &file->undo, &file->cursorX, &file->cursorY,
+                            &file->numberOfRows, &file->unsavedChanges);
+      } else {
+        editorInsertChar(record->text[i], file->buffer, &file->undo, &file->numberOfRows,
+                         &file->unsavedChanges, &file->cursorX, file->cursorY);
+      }
+    }
+    break;
+  case JournalDelete:
+    editorDeleteChar(file->buffer, &file->undo, &file->cursorX, &file->cursorY,
+                     &file->unsavedChanges, &file->numberOfRows);
+    break;
+  case JournalUndo:
+    free(editorUndo(file));
+    return;
+  case JournalRedo:
+    free(editorRedo(file));
     return;
   }
-  memcpy(&new[ab->len], s, len);
-  ab->b = new;
-  ab->len += len;
+  if (file->undo != undo) editorClearRedo(file);
 }
 
-void abFree(struct abuf *ab) {
-  free(ab->b);
+/**
+ * Start journalling file, first making the edits in the journal left behind
+ * if the editor didn't quit the last time it edited the file. If another
+ * editor has the file's journal open, its edits are left to it, and this
+ * one doesn't journal.
+ */
+void editorRecover(FileData *file) {
+  int count;
+  file->journal = journalRecover(file->filename, editorReplay, file, &count);
+  if (file->journal == NULL && errno == EWOULDBLOCK) {
+    editorSetStatusMessage("Another kibi is editing %s: edits here won't be journalled", file->filename);
+  } else if (count > 0) {
+    editorSetStatusMessage("Recovered %d edits from the journal. Ctrl-s to save them.", count);
+  }
 }
 
 /*** output ***/
@@ -640,10 +849,10 @@ void abFree(struct abuf *ab) {
 void splitBelow(Display *display) {
   int upperHeight = display->height / 2;
   int lowerHeight = display->height - upperHeight;
-  int x = display->panes->active->active->cursorX;
-  int y = display->panes->active->active->cursorY;
-  int top = display->panes->active->active->top;
-  int left = display->panes->active->active->left;
+  int64_t x = display->panes->active->active->cursorX;
+  int64_t y = display->panes->active->active->cursorY;
+  int64_t top = display->panes->active->active->top;
+  int64_t left = display->panes->active->active->left;
   FileData *file = display->panes->active->active->file;
   Pane *newPane = makePane(x, y, top, left, file);
   DisplayRow *newRow = makeDisplayRow(NULL, newPane, NULL);
@@ -651,11 +860,7 @@ void splitBelow(Display *display) {
 }
 
 void editorScroll(Pane *pane) {
-  pane->cursorX = 0;
-  EditorRow *current = editorCurrentRow(pane->file->buffer);
-  if (current != NULL) {
-    pane->cursorX = editorCursorToRender(current, pane->file->cursorX, tabSize);
-  }
+  pane->cursorX = zipperCursorToRender(pane->file->buffer, pane->file->cursorX, tabSize);
   if (pane->cursorX < pane->left) {
     pane->left = pane->cursorX;
   }
@@ -672,34 +877,31 @@ void editorScroll(Pane *pane) {
   pane->cursorY = pane->file->cursorY - pane->top;
 }
 
-void editorDrawString(struct abuf *ab, char *s, int length) {
-  abAppend(ab, s, length);
+void editorDrawString(Screen *screen, char *s, int length) {
+  screenWrite(screen, s, length);
 }
 
-void editorDrawBlanks(struct abuf *ab, int n) {
-  for (; n > 0; n--) {
-    abAppend(ab, " ", 1);
-  }
+void editorDrawBlanks(Screen *screen, int n) {
+  screenBlanks(screen, n);
 }
 
-void editorDrawNewline(struct abuf *ab) {
-  abAppend(ab, "\r\n", 2);
+void editorDrawNewline(Screen *screen) {
+  screenNewline(screen);
 }
 
-void editorDrawLine(struct abuf *ab, char *s, int length) {
-  editorDrawString(ab, s, length);
-  editorDrawNewline(ab);
+void editorDrawLine(Screen *screen, char *s, int length) {
+  editorDrawString(screen, s, length);
+  editorDrawNewline(screen);
 }
 
-void editorDrawEmpties(struct abuf *ab, int numberOfLines) {
-  editorDrawLine(ab, "~", 1);
-  if (numberOfLines > 1) {
-    editorDrawEmpties(ab, numberOfLines - 1);
+void editorDrawEmpties(Screen *screen, int numberOfLines) {
+  for (; numberOfLines > 0; numberOfLines--) {
+    editorDrawLine(screen, "~", 1);
   }
 }
 
-void editorDrawWelcome(struct abuf *ab) {
-  editorDrawEmpties(ab, editor.display.height / 3 - 1);
+void editorDrawWelcome(Screen *screen) {
+  editorDrawEmpties(screen, editor.display.height / 3 - 1);
   char welcome[80];
   int welcomeLength = snprintf(
     welcome,
@@ -712,75 +914,66 @@ void editorDrawWelcome(struct abuf *ab) {
   }
   int padding = (editor.display.width - welcomeLength) / 2;
   if (padding) {
-    abAppend(ab, "~", 1);
+    screenWrite(screen, "~", 1);
     padding--;
   }
-  while (padding--) abAppend(ab, " ", 1);
-  abAppend(ab, welcome, welcomeLength);
+  screenBlanks(screen, padding);
+  screenWrite(screen, welcome, welcomeLength);
 }
 
-void editorDrawRows(struct abuf *ab) {
+void editorDrawRows(Screen *screen) {
   if (activePane(&editor.display)->file->numberOfRows == 0) {
-    editorDrawWelcome(ab);
+    editorDrawWelcome(screen);
   } else {
-    List(List(List(PaneRow))) *paneRows =
-      drawDisplayColumn(editor.display.panes, editor.display.height, editor.display.width);
+    Frame *frame = &editor.frame;
+    drawDisplayColumn(frame, editor.display.panes, editor.display.height, editor.display.width);
 
     int linesDrawn = 0;
-    List(List(List(PaneRow))) *rows = paneRows;
-    // for each column
-    while (rows != NULL && linesDrawn < editor.display.height) {
-      List(List(PaneRow)) *panes = rows->head;
-      // for each row in the column
-      while (panes->head != NULL && linesDrawn < editor.display.height) {
-        int charactersDrawn = 0;
-        List(List(PaneRow)) *panes2 = panes;
-        // for each pane in the row, print the current line
-        while (panes2 != NULL) {
-          List(PaneRow) *pane = panes2->head;
-          int proposedWidth = pane->head->width + pane->head->blanks;
-          int widthAvailable = editor.display.width - charactersDrawn;
-          int rowWidth = pane->head->width > widthAvailable ? widthAvailable : pane->head->width;
-          int totalWidth =
-            proposedWidth > widthAvailable ? widthAvailable : proposedWidth;
-          editorDrawString(ab, pane->head->row, rowWidth);
-          if (rowWidth < totalWidth) {
-            editorDrawBlanks(ab, totalWidth - rowWidth);
-          }
-          charactersDrawn += totalWidth;
-          // move pane pointer to next row
-          List(PaneRow) *current = panes2->head;
-          panes2->head = panes2->head->tail;
-          // that row (cons cell) is no longer needed
-          free(current);
-          // move to next pane
-          panes2 = panes2->tail;
+    for (; linesDrawn < frame->height && linesDrawn < editor.display.height; linesDrawn++) {
+      FrameLine *line = &frame->lines[linesDrawn];
+      int charactersDrawn = 0;
+      // for each pane in the line
+      for (int i = 0; i < line->count; i++) {
+        PaneRow *paneRow = &frame->rows[line->start + i];
+        int proposedWidth = paneRow->width + paneRow->blanks;
+        int widthAvailable = editor.display.width - charactersDrawn;
+        int rowWidth = paneRow->width > widthAvailable ? widthAvailable : paneRow->width;
+        int totalWidth =
+          proposedWidth > widthAvailable ? widthAvailable : proposedWidth;
+        if (paneRow->reverse) {
+          screenWrite(screen, "\x1b[7m", 4);
+        }
+        editorDrawString(screen, paneRow->row, rowWidth);
+        if (rowWidth < totalWidth) {
+          editorDrawBlanks(screen, totalWidth - rowWidth);
+        }
+        if (paneRow->reverse) {
+          screenWrite(screen, "\x1b[27m", 5);
         }
-        editorDrawNewline(ab);
-        linesDrawn++;
+        charactersDrawn += totalWidth;
       }
-      // we've done all the panes in this row
-      ListF(List(PaneRow)).free(panes);
-      List(List(List(PaneRow))) *finishedRow = rows;
-      rows = rows->tail;
-      free(finishedRow);
+      editorDrawNewline(screen);
     }
     if (linesDrawn < editor.display.height) {
-      editorDrawEmpties(ab, editor.display.height - linesDrawn);
+      editorDrawEmpties(screen, editor.display.height - linesDrawn);
+    }
+    for (size_t i = 0; i < frame->scrollCount; i++) {
+      FrameScroll *scroll = &frame->scrolls[i];
+      screenScroll(screen, scroll->top, scroll->top + scroll->height,
+                   scroll->left, scroll->width, scroll->delta);
     }
   }
 }
 
 
-void editorDrawMessageBar(struct abuf *ab) {
-  abAppend(ab, "\x1b[K", 3);
-  abAppend(ab, "\x1b[7m", 4);
+void editorDrawMessageBar(Screen *screen) {
+  screenWrite(screen, "\x1b[7m", 4);
   int messageLength = strlen(editor.statusMessage);
   if (messageLength > editor.display.width) messageLength = editor.display.width;
   if (messageLength && time(NULL) - editor.statusMessageTime < 5) {
-    abAppend(ab, editor.statusMessage, messageLength);
+    screenWrite(screen, editor.statusMessage, messageLength);
   }
-  abAppend(ab, "\x1b[27m", 5);
+  screenWrite(screen, "\x1b[27m", 5);
 }
 
 void editorUpdateWindowSize() {
@@ -792,21 +985,23 @@ void editorUpdateWindowSize() {
 void editorRefreshScreen() {
   editorUpdateWindowSize();
   editorScroll(activePane(&editor.display));
-  struct abuf ab = ABUF_INIT;
-
-  abAppend(&ab, "\x1b[?25l", 6);
-  abAppend(&ab, "\x1b[H", 3);
-
-  editorDrawRows(&ab);
-  editorDrawMessageBar(&ab);
-  char buf[32];
+  screenResize(&editor.screen, editor.display.height + 1, editor.display.width);
+  screenStart(&editor.screen);
+  editorDrawRows(&editor.screen);
+  editorDrawMessageBar(&editor.screen);
+
+  struct abuf *ab = &editor.output;
+  abClear(ab);
+  abAppend(ab, "\x1b[?25l", 6);
+  screenFlush(&editor.screen, ab);
   ScreenCursor c = activeCursor(&editor.display);
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", c.y, c.x);
-  abAppend(&ab, buf, strlen(buf));
-  abAppend(&ab, "\x1b[?25h", 6);
+  char *span = abReserve(ab, 32);
+  if (span != NULL) {
+    abCommit(ab, snprintf(span, 32, "\x1b[%d;%dH", c.y, c.x));
+  }
+  abAppend(ab, "\x1b[?25h", 6);
 
-  write(STDOUT_FILENO, ab.b, ab.len);
-  abFree(&ab);
+  write(STDOUT_FILENO, ab->b, ab->len);
 }
 
 void editorSetStatusMessage(const char *format, ...) {
@@ -823,33 +1018,57 @@ void editorSwitchPane() {
   // TODO
 }
 
-void editorMoveCursor(ZipperBuffer *buffer, int *cursorX, int *cursorY, int key) {
-  EditorRow *row = editorCurrentRow(buffer);
+/**
+ * The screen column of the cursor, or -1 if it isn't on a row, for
+ * editorKeepColumn.
+ */
+int64_t editorCursorColumn(ZipperBuffer *buffer, int64_t cursorX) {
+  if (zipperCurrentLength(buffer) < 0) return -1;
+  return zipperCursorToRender(buffer, cursorX, tabSize);
+}
+
+/**
+ * After moving to another line from the one at index line, put the cursor
+ * in the same column onscreen as it was (renderX, from editorCursorColumn),
+ * rather than at the same character index.
+ */
+void editorKeepColumn(ZipperBuffer *buffer, int64_t line, int64_t renderX, int64_t *cursorX) {
+  if (renderX < 0 || buffer->cursor == line) return;
+  EditorRow *current = editorCurrentRow(buffer);
+  if (current == NULL) return;
+  *cursorX = editorRenderToCursor(current, renderX, tabSize);
+}
+
+/**
+ * Move the cursor. Moves along the row don't close it if it's open (see
+ * zipperCurrentLength), so typing can carry on in the same gap buffer.
+ */
+void editorMoveCursor(ZipperBuffer *buffer, int64_t *cursorX, int64_t *cursorY, int key) {
+  int64_t line = buffer->cursor;
+  int64_t length = zipperCurrentLength(buffer);
   switch (key) {
   case ARROW_DOWN:
   case CTRL_KEY('n'): {
-    struct Navigation n = {.type = ToNext, .objectType = Line};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
+    editorLogNavigation((struct Navigation){.type = ToNext, .objectType = Line});
+    int64_t renderX = editorCursorColumn(buffer, *cursorX);
     editorForwardLine(buffer, cursorY);
+    editorKeepColumn(buffer, line, renderX, cursorX);
     break;
   }
   case ARROW_UP:
   case CTRL_KEY('p'): {
-    struct Navigation n = {.type = ToPrevious, .objectType = Line};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
+    editorLogNavigation((struct Navigation){.type = ToPrevious, .objectType = Line});
+    int64_t renderX = editorCursorColumn(buffer, *cursorX);
     editorBackwardLine(buffer, cursorY);
+    editorKeepColumn(buffer, line, renderX, cursorX);
     break;
   }
   case ARROW_RIGHT:
   case CTRL_KEY('f'): {
-    struct Navigation n = {.type = ToNext, .objectType = Character};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
-    if (row && *cursorX < row->size) {
+    editorLogNavigation((struct Navigation){.type = ToNext, .objectType = Character});
+    if (length >= 0 && *cursorX < length) {
       *cursorX += 1;
-    } else if (row && *cursorX == row->size) {
+    } else if (length >= 0 && *cursorX == length) {
       editorForwardLine(buffer, cursorY);
       *cursorX = 0;
     }
@@ -857,21 +1076,19 @@ void editorMoveCursor(ZipperBuffer *buffer, int *cursorX, int *cursorY, int key)
   }
   case ARROW_LEFT:
   case CTRL_KEY('b'): {
-    struct Navigation n = {.type = ToPrevious, .objectType = Line};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
+    editorLogNavigation((struct Navigation){.type = ToPrevious, .objectType = Line});
     if (*cursorX > 0) {
       *cursorX -= 1;
     } else if (editorPreviousRow(buffer) != NULL) {
       editorBackwardLine(buffer, cursorY);
-      *cursorX = buffer->forwards->head->size;
+      *cursorX = zipperCurrentLength(buffer);
     }
     break;
   }
   }
 
-  row = editorCurrentRow(buffer);
-  int rowLength = row ? row->size : 0;
+  int64_t rowLength = zipperCurrentLength(buffer);
+  if (rowLength < 0) rowLength = 0;
   if (*cursorX > rowLength) {
     *cursorX = rowLength;
   }
@@ -881,13 +1098,11 @@ void editorProcessKeypress() {
   static int quitTimes = 1;
   int c = editorReadKey();
   FileData *fileData = activePane(&editor.display)->file;
+  UndoStack *undo = fileData->undo;
 
   switch (c) {
   case '\r': {
-    struct Edit e = {.type = InsertText, .insert = {.text = "\n"}};
-    struct String s = editToString(e);
-    editor.log(s.s);
-    free(s.s);
+    editorLogEdit(fileData, (struct Edit){.type = InsertText, .insert = {.text = "\n", .length = 1}});
     editorInsertNewline(
       fileData->buffer,
       &fileData->undo,
@@ -899,53 +1114,58 @@ void editorProcessKeypress() {
     break;
   }
   case CTRL_KEY('z'): {
+    editorJournal(fileData, JournalUndo, NULL, 0);
     onFailure(editorUndo(fileData), editorSetStatusMessage);
     break;
   }
   case CTRL_KEY('y'):
+    editorJournal(fileData, JournalRedo, NULL, 0);
     onFailure(editorRedo(fileData), editorSetStatusMessage);
     break;
   case CTRL_KEY('x'):
     editorUndoSteps(fileData->undo);
     break;
+  case CTRL_KEY('t'):
+    editorPackStats();
+    break;
+  case SAVE_FINISHED:
+  case LINES_INDEXED:
+    // not keys: just for the screen to be redrawn
+    return;
   case CTRL_KEY('q'):
+    editorFinishSave(fileData);
     if (fileData->unsavedChanges && quitTimes > 0) {
       editorSetStatusMessage("There are unsaved changes. Press Ctrl-q again to quit.");
       quitTimes = 0;
       return;
     }
+    if (fileData->journal != NULL) journalClose(fileData->journal, true);
+    editorStoreCursor(fileData);
     write(STDOUT_FILENO, "\x1b[2J", 4);
     write(STDOUT_FILENO, "\x1b[H", 3);
     exit(0);
     break;
   case CTRL_KEY('s'):
-    editorSave(fileData->buffer, fileData->filename, &fileData->unsavedChanges);
+    editorSave(fileData);
     break;
   case HOME_KEY:
   case CTRL_KEY('a'): {
-    struct Navigation n = {.type = ToStartOf, .objectType = Line};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
+    editorLogNavigation((struct Navigation){.type = ToStartOf, .objectType = Line});
     fileData->cursorX = 0;
     break;
   }
   case END_KEY:
   case CTRL_KEY('e'): {
-    struct Navigation n = {.type = ToEndOf, .objectType = Line};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
-    EditorRow *current = editorCurrentRow(fileData->buffer);
-    if (current != NULL) {
-      fileData->cursorX = current->size;
+    editorLogNavigation((struct Navigation){.type = ToEndOf, .objectType = Line});
+    int64_t length = zipperCurrentLength(fileData->buffer);
+    if (length >= 0) {
+      fileData->cursorX = length;
     }
     break;
   }
   case BACKSPACE:
   case CTRL_KEY('h'): {
-    struct Edit e = {.type = DeleteText, .delete = {.object = {.type = Character}}};
-    struct String s = editToString(e);
-    editor.log(s.s);
-    free(s.s);
+    editorLogEdit(fileData, (struct Edit){.type = DeleteText, .delete = {.object = {.type = Character}}});
     editorDeleteChar(
       fileData->buffer,
       &fileData->undo,
@@ -958,6 +1178,7 @@ void editorProcessKeypress() {
   }
   case DELETE_KEY:
     editorMoveCursor(fileData->buffer, &fileData->cursorX, &fileData->cursorY, ARROW_RIGHT);
+    editorLogEdit(fileData, (struct Edit){.type = DeleteText, .delete = {.object = {.type = Character}}});
     editorDeleteChar(
       fileData->buffer,
       &fileData->undo,
@@ -972,35 +1193,24 @@ void editorProcessKeypress() {
   case CTRL_KEY('u'):
   case CTRL_KEY('d'):
     {
+      int64_t top = activePane(&editor.display)->top;
+      int height = activeHeight(&editor.display);
+      int64_t line;
       if (c == PAGE_UP || c == CTRL_KEY('u')) {
-        struct Navigation n = {.type = ToPrevious, .objectType = Page};
-        struct String s = navigationToString(n);
-        editor.log(s.s);
-        fileData->cursorY = activePane(&editor.display)->top;
+        editorLogNavigation((struct Navigation){.type = ToPrevious, .objectType = Page});
+        line = top - height;
       } else {
-        struct Navigation n = {.type = ToNext, .objectType = Page};
-        struct String s = navigationToString(n);
-        editor.log(s.s);
-        fileData->cursorY = activePane(&editor.display)->top + activeHeight(&editor.display) - 1;
-        if (fileData->cursorY > fileData->numberOfRows) {
-          fileData->cursorY = fileData->numberOfRows;
-        }
-      }
-      int times = activeHeight(&editor.display);
-      while (times--) {
-        editorMoveCursor(
-          fileData->buffer,
-          &fileData->cursorX,
-          &fileData->cursorY,
-          (c == PAGE_UP || c == CTRL_KEY('u')) ? ARROW_UP : ARROW_DOWN
-      );
+        editorLogNavigation((struct Navigation){.type = ToNext, .objectType = Page});
+        line = top + 2 * height - 1;
       }
+      editorJumpToLine(fileData->buffer, &fileData->cursorX, &fileData->cursorY, line);
     }
     break;
   case CTRL_KEY('g'): {
-    struct Navigation n = {.type = ToEndOf, .objectType = Buffer};
-    struct String s = navigationToString(n);
-    editor.log(s.s);
+    editorLogNavigation((struct Navigation){.type = ToEndOf, .objectType = Buffer});
+    while (fileData->indexing != NULL) {
+      editorIndexMore(fileData);
+    }
     editorJumpToEnd(fileData->buffer, &fileData->cursorY);
     break;
   }
@@ -1021,13 +1231,8 @@ void editorProcessKeypress() {
     editorSwitchPane();
     break;
   default: {
-    char *text = malloc(sizeof(char) * 2);
-    text[0] = c; text[1] = 0;
-    struct Edit e = {.type = InsertText, .insert = {.text = text}};
-    struct String s = editToString(e);
-    editor.log(s.s);
-    free(s.s);
-    free(text);
+    char text[2] = {c, 0};
+    editorLogEdit(fileData, (struct Edit){.type = InsertText, .insert = {.text = text, .length = 1}});
     editorInsertChar(
       c,
       fileData->buffer,
@@ -1039,16 +1244,42 @@ void editorProcessKeypress() {
   );
   }
   }
+  if (fileData->undo != undo && c != CTRL_KEY('z') && c != CTRL_KEY('y')) {
+    // a new edit: what's on the redo stack no longer follows on from it
+    editorClearRedo(fileData);
+  }
   quitTimes = 1;
 }
 
 /*** init ***/
 
+/**
+ * Whether the terminal can set a scrolling region (DECSTBM), which every
+ * terminal since the VT100 can.
+ */
+bool terminalScrollsRegions() {
+  const char *term = getenv("TERM");
+  return term != NULL && strcmp(term, "dumb") != 0 && strncmp(term, "vt52", 4) != 0;
+}
+
+/**
+ * Whether the terminal can erase characters where they are (ECH). Every
+ * terminal since the VT220 can; the ones before aren't worth the escape.
+ */
+bool terminalErasesCharacters() {
+  const char *term = getenv("TERM");
+  return term != NULL && strcmp(term, "dumb") != 0 && strncmp(term, "vt52", 4) != 0
+    && strncmp(term, "vt100", 5) != 0 && strncmp(term, "vt102", 5) != 0;
+}
+
+/**
+ * Start the editor, with an empty buffer. If KIBI_ROPE is set, buffers keep
+ * their text in a rope rather than rows (see zipperRopeBuffer).
+ */
 void initEditor() {
-  ZipperBuffer *emptyBuffer = malloc(sizeof(ZipperBuffer));
-  emptyBuffer->forwards = NULL;
-  emptyBuffer->backwards = NULL;
-  emptyBuffer->newest = NULL;
+  ZipperBuffer *emptyBuffer = getenv("KIBI_ROPE") != NULL
+    ? zipperRopeBuffer(NULL, 0, tabSize)
+    : zipperBuffer(NULL, 0);
   FileData *emptyFile = fileData(0, 0, 0, emptyBuffer, NULL, 0, NULL, NULL);
   Pane *pane = makePane(0, 0, 0, 0, emptyFile);
   DisplayRow *row = makeDisplayRow(NULL, pane, NULL);
@@ -1057,7 +1288,10 @@ void initEditor() {
 
   editor.statusMessage[0] = '\0';
   editor.statusMessageTime = 0;
+  editor.packedAt = time(NULL);
   editor.log = stderrLog;
+  editor.screen.eraseCharacters = terminalErasesCharacters();
+  editor.screen.scrollRegions = terminalScrollsRegions();
 
   editorUpdateWindowSize();
 }
@@ -1076,16 +1310,19 @@ int main(int argc, char *argv[]) {
       argv[1],
       &activePane(&editor.display)->file->filename,
       activePane(&editor.display)->file->buffer,
-      &activePane(&editor.display)->file->undo,
       &activePane(&editor.display)->file->unsavedChanges,
       &activePane(&editor.display)->file->numberOfRows,
-      activePane(&editor.display)->file->cursorX,
-      activePane(&editor.display)->file->cursorY
+      &activePane(&editor.display)->file->indexing,
+      &activePane(&editor.display)->file->cursorX,
+      &activePane(&editor.display)->file->cursorY
   );
+    FileData *file = activePane(&editor.display)->file;
+    editorGoToLine(file, file->cursorY);
     splitBelow(&editor.display);
   }
   
   editorSetStatusMessage("Ctrl-q to quit, Ctrl-s to save");
+  if (argc >= 2) editorRecover(activePane(&editor.display)->file);
   
   while (1) {
     editorRefreshScreen();
@@ -0,0 +1,250 @@
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lineCache.h"
+#include "mappedFile.h"
+
+static const char magic[8] = "KIBILIN2";
+
+/**
+ * Bytes of the file hashed from each of SAMPLES places spread through it.
+ */
+#define SAMPLE_SIZE 4096
+#define SAMPLES 16
+
+/**
+ * Index entries checked against the file when a cache is loaded.
+ */
+#define CHECKS 16
+
+/**
+ * What a cache starts with, after the magic: the file's size, modification
+ * time, sampled hash and bytes indexed, LINE_INDEX_STRIDE, the number of
+ * lines indexed, the cursor and the length of the file's path. The path
+ * comes next, and then the index.
+ */
+typedef struct Header {
+  int64_t size, seconds, nanoseconds;
+  uint64_t hash;
+  int64_t indexed, stride;
+  int64_t count, cursorX, cursorY, pathLength;
+} Header;
+
+#define CURSOR_OFFSET (sizeof(magic) + offsetof(Header, cursorX))
+
+static uint64_t hashBytes(uint64_t hash, const char *s, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)s[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+static uint64_t sampledHash(MappedFile *file) {
+  uint64_t hash = 0xcbf29ce484222325;
+  if (file->size <= SAMPLES * SAMPLE_SIZE) {
+    return hashBytes(hash, file->data, file->size);
+  }
+  for (int i = 0; i < SAMPLES; i++) {
+    size_t at = (file->size - SAMPLE_SIZE) / (SAMPLES - 1) * i;
+    hash = hashBytes(hash, file->data + at, SAMPLE_SIZE);
+  }
+  return hash;
+}
+
+char *lineCachePath(const char *filename) {
+  char *full = realpath(filename, NULL);
+  if (full == NULL) return NULL;
+  const char *home = getenv("XDG_CACHE_HOME");
+  const char *directory = "";
+  if (home == NULL || home[0] == '\0') {
+    home = getenv("HOME");
+    directory = "/.cache";
+    if (home == NULL) {
+      free(full);
+      return NULL;
+    }
+  }
+  char *path = malloc(strlen(home) + strlen(directory) + 32);
+  sprintf(path, "%s%s/kibi/%016llx", home, directory,
+          (unsigned long long)hashBytes(0xcbf29ce484222325, full, strlen(full)));
+  free(full);
+  return path;
+}
+
+/**
+ * Make the directory path is in, and the one that's in, if they aren't
+ * there already.
+ */
+static void makeDirectories(const char *path) {
+  char *directory = strdup(path);
+  char *kibi = strrchr(directory, '/');
+  *kibi = '\0';
+  char *cache = strrchr(directory, '/');
+  if (cache != NULL && cache != directory) {
+    *cache = '\0';
+    mkdir(directory, 0700);
+    *cache = '/';
+  }
+  mkdir(directory, 0700);
+  free(directory);
+}
+
+/**
+ * Read filename's cache header and path. Returns the open cache, or -1 if
+ * there isn't one, it isn't for filename, or it's for a different version
+ * of it than size and modified (checked against filename itself if modified
+ * is NULL).
+ */
+static int openCache(const char *filename, int flags, Header *header,
+                     size_t size, struct timespec *modified) {
+  char *path = lineCachePath(filename);
+  char *full = realpath(filename, NULL);
+  if (path == NULL || full == NULL) {
+    free(path);
+    free(full);
+    return -1;
+  }
+  int fileDescriptor = open(path, flags);
+  free(path);
+  struct stat status;
+  char start[8];
+  bool matches = fileDescriptor != -1 &&
+    read(fileDescriptor, start, 8) == 8 && memcmp(start, magic, 8) == 0 &&
+    read(fileDescriptor, header, sizeof(*header)) == sizeof(*header) &&
+    header->stride == LINE_INDEX_STRIDE &&
+    (size_t)header->pathLength == strlen(full);
+  if (matches && modified == NULL) {
+    matches = stat(filename, &status) == 0;
+    size = status.st_size;
+    modified = &status.st_mtim;
+  }
+  matches = matches && header->size == (int64_t)size &&
+    header->seconds == modified->tv_sec && header->nanoseconds == modified->tv_nsec;
+  if (matches) {
+    char *stored = malloc(header->pathLength);
+    matches = read(fileDescriptor, stored, header->pathLength) == header->pathLength &&
+      memcmp(stored, full, header->pathLength) == 0;
+    free(stored);
+  }
+  free(full);
+  if (!matches && fileDescriptor != -1) {
+    close(fileDescriptor);
+    return -1;
+  }
+  return fileDescriptor;
+}
+
+/**
+ * Whether lines looks like an index of the first indexed bytes of file: the
+ * entries go up from 0, stay within indexed, and (for a few of them) follow
+ * a newline.
+ */
+static bool plausible(MappedFile *file, size_t *lines, int64_t entries, size_t indexed) {
+  if (entries == 0 || lines[0] != 0) return false;
+  for (int64_t k = 1; k < entries; k++) {
+    if (lines[k] <= lines[k - 1] || lines[k] >= indexed) return false;
+  }
+  int64_t step = entries / CHECKS + 1;
+  for (int64_t k = step; k < entries; k += step) {
+    if (file->data[lines[k] - 1] != '\n') return false;
+  }
+  return indexed == file->size || file->data[indexed - 1] == '\n';
+}
+
+bool lineCacheLoad(const char *filename, MappedFile *file, int64_t *cursorX,
+                   int64_t *cursorY) {
+  Header header;
+  int fileDescriptor = openCache(filename, O_RDONLY, &header, file->size, &file->modified);
+  if (fileDescriptor == -1) return false;
+  int64_t entries = (header.count + LINE_INDEX_STRIDE - 1) / LINE_INDEX_STRIDE;
+  size_t *lines = NULL;
+  bool loaded = header.count > 0 && header.indexed > 0 &&
+    (size_t)header.indexed <= file->size && header.hash == sampledHash(file);
+  if (loaded) {
+    size_t bytes = entries * sizeof(size_t);
+    lines = malloc(bytes);
+    loaded = read(fileDescriptor, lines, bytes) == (ssize_t)bytes &&
+      plausible(file, lines, entries, header.indexed);
+  }
+  close(fileDescriptor);
+  if (!loaded || header.count <= file->count) {
+    free(lines);
+    return false;
+  }
+  free(file->lines);
+  file->lines = lines;
+  file->count = header.count;
+  file->indexed = header.indexed;
+  *cursorX = header.cursorX;
+  *cursorY = header.cursorY;
+  return true;
+}
+
+bool lineCacheStore(const char *filename, MappedFile *file, int64_t cursorX,
+                    int64_t cursorY) {
+  struct stat status;
+  char *full = realpath(filename, NULL);
+  char *path = lineCachePath(filename);
+  if (full == NULL || path == NULL || stat(filename, &status) == -1 ||
+      (size_t)status.st_size != file->size ||
+      status.st_mtim.tv_sec != file->modified.tv_sec ||
+      status.st_mtim.tv_nsec != file->modified.tv_nsec) {
+    free(full);
+    free(path);
+    return false;
+  }
+  Header header = {
+    .size = file->size,
+    .seconds = file->modified.tv_sec,
+    .nanoseconds = file->modified.tv_nsec,
+    .hash = sampledHash(file),
+    .indexed = file->indexed,
+    .stride = LINE_INDEX_STRIDE,
+    .count = file->count,
+    .cursorX = cursorX,
+    .cursorY = cursorY,
+    .pathLength = strlen(full)
+  };
+  size_t entries = (file->count + LINE_INDEX_STRIDE - 1) / LINE_INDEX_STRIDE;
+
+  // write a new cache and move it into place, so that a cache is never seen
+  // half written
+  makeDirectories(path);
+  char *temporary = malloc(strlen(path) + 8);
+  sprintf(temporary, "%s.XXXXXX", path);
+  int fileDescriptor = mkstemp(temporary);
+  FILE *out = fileDescriptor == -1 ? NULL : fdopen(fileDescriptor, "w");
+  bool stored = out != NULL &&
+    fwrite(magic, 8, 1, out) == 1 &&
+    fwrite(&header, sizeof(header), 1, out) == 1 &&
+    fwrite(full, header.pathLength, 1, out) == 1 &&
+    fwrite(file->lines, sizeof(size_t), entries, out) == entries;
+  if (out != NULL) {
+    stored = fclose(out) == 0 && stored;
+  } else if (fileDescriptor != -1) {
+    close(fileDescriptor);
+  }
+  stored = stored && rename(temporary, path) == 0;
+  if (!stored && fileDescriptor != -1) unlink(temporary);
+  free(temporary);
+  free(full);
+  free(path);
+  return stored;
+}
+
+bool lineCacheStoreCursor(const char *filename, int64_t cursorX, int64_t cursorY) {
+  Header header;
+  int fileDescriptor = openCache(filename, O_RDWR, &header, 0, NULL);
+  if (fileDescriptor == -1) return false;
+  int64_t cursor[2] = {cursorX, cursorY};
+  bool stored = pwrite(fileDescriptor, cursor, sizeof(cursor), CURSOR_OFFSET) == sizeof(cursor);
+  close(fileDescriptor);
+  return stored;
+}
@@ -0,0 +1,47 @@
+#ifndef LINE_CACHE
+#define LINE_CACHE
+
+#include <stdbool.h>
+#include "mappedFile.h"
+
+/**
+ * A big file's line index (see MappedFile), and where the cursor was left in
+ * it, kept in the user's cache directory ($XDG_CACHE_HOME/kibi, or
+ * ~/.cache/kibi) so that opening the file again doesn't have to scan it.
+ *
+ * Each file's cache is named after a hash of its full path. It starts with a
+ * header saying which version of the file it's for: its size, modification
+ * time, a hash of a few samples spread through it, and the path itself. A
+ * cache that doesn't match the file as it is now is stale, and isn't used;
+ * it's replaced the next time the file is indexed.
+ */
+
+/**
+ * The path of filename's cache, or NULL if it doesn't have one (e.g. the
+ * file doesn't exist).
+ */
+char *lineCachePath(const char *filename);
+
+/**
+ * Replace the index of file, which was mapped from filename, with its cached
+ * one, and set cursorX and cursorY to where the cursor was left. The cached
+ * index may cover more of the file than file's own. Returns false, and
+ * leaves everything as it was, if there's no cache or it's stale.
+ */
+bool lineCacheLoad(const char *filename, MappedFile *file, int64_t *cursorX,
+                   int64_t *cursorY);
+
+/**
+ * Cache as much of file's index as has been built, along with the cursor.
+ * Does nothing (and returns false) if filename has changed since file was
+ * mapped from it.
+ */
+bool lineCacheStore(const char *filename, MappedFile *file, int64_t cursorX,
+                    int64_t cursorY);
+
+/**
+ * Change the cursor in filename's cache, if it has one that isn't stale.
+ */
+bool lineCacheStoreCursor(const char *filename, int64_t cursorX, int64_t cursorY);
+
+#endif
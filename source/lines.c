@@ -0,0 +1,228 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "editorRow.h"
+#include "lines.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LINES_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Size of the blocks readLines reads.
+ */
+#define READ_BLOCK (1 << 18)
+
+/**
+ * How much of a range indexRange scans at a time.
+ */
+#define INDEX_BLOCK (1 << 16)
+
+static size_t scalarSplit(const char *s, size_t length, size_t base, size_t *starts) {
+  size_t n = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (s[i] == '\n') {
+      starts[n++] = base + i + 1;
+    }
+  }
+  return n;
+}
+
+const LineKernels scalarLineKernels = {"scalar", scalarSplit};
+
+#ifdef LINES_X86
+
+__attribute__((target("sse2")))
+static size_t sse2Split(const char *s, size_t length, size_t base, size_t *starts) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    while (mask != 0) {
+      starts[n++] = base + i + __builtin_ctz(mask) + 1;
+      mask &= mask - 1;
+    }
+  }
+  return n + scalarSplit(s + i, length - i, base + i, starts + n);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2Split(const char *s, size_t length, size_t base, size_t *starts) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + i));
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+    while (mask != 0) {
+      starts[n++] = base + i + __builtin_ctz(mask) + 1;
+      mask &= mask - 1;
+    }
+  }
+  return n + sse2Split(s + i, length - i, base + i, starts + n);
+}
+
+static const LineKernels sse2LineKernels = {"sse2", sse2Split};
+
+static const LineKernels avx2LineKernels = {"avx2", avx2Split};
+
+#endif
+
+const LineKernels *lineKernels(void) {
+  static const LineKernels *kernels = NULL;
+  if (kernels == NULL) {
+    kernels = &scalarLineKernels;
+#ifdef LINES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      kernels = &avx2LineKernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+      kernels = &sse2LineKernels;
+    }
+#endif
+  }
+  return kernels;
+}
+
+size_t splitLines(const char *s, size_t length, size_t base, size_t *starts) {
+  return lineKernels()->split(s, length, base, starts);
+}
+
+/**
+ * Part of the text for one thread to index.
+ *
+ * kernels: Picked before the threads start, so they don't race to pick.
+ * start, end: The part of s to scan.
+ * lines, count: The starts of the lines found in it (only counting those
+ *   after a newline, apart from the first line of the text).
+ */
+typedef struct IndexRange {
+  const LineKernels *kernels;
+  const char *s;
+  size_t start;
+  size_t end;
+  size_t *lines;
+  size_t count;
+} IndexRange;
+
+static void *indexRange(void *argument) {
+  IndexRange *range = argument;
+  size_t capacity = INDEX_BLOCK + 2;
+  range->lines = malloc(capacity * sizeof(size_t));
+  range->count = 0;
+  if (range->start == 0) {
+    range->lines[range->count++] = 0;
+  }
+  for (size_t offset = range->start; offset < range->end; offset += INDEX_BLOCK) {
+    size_t length = range->end - offset < INDEX_BLOCK ? range->end - offset : INDEX_BLOCK;
+    if (range->count + length + 1 > capacity) {
+      capacity = 2 * capacity + length;
+      range->lines = realloc(range->lines, capacity * sizeof(size_t));
+    }
+    range->count += range->kernels->split(range->s + offset, length, offset, range->lines + range->count);
+  }
+  return NULL;
+}
+
+size_t *indexLines(const char *s, size_t length, int threads, int64_t *count) {
+  if (threads < 1) threads = 1;
+  if (threads > LINES_MAX_THREADS) threads = LINES_MAX_THREADS;
+  IndexRange ranges[LINES_MAX_THREADS];
+  pthread_t workers[LINES_MAX_THREADS];
+  bool started[LINES_MAX_THREADS];
+  const LineKernels *kernels = lineKernels();
+  // a range can start in the middle of a line: each one only records the
+  // lines started by its newlines, so no newline is counted twice
+  for (int i = 0; i < threads; i++) {
+    ranges[i] = (IndexRange){kernels, s, length * i / threads, length * (i + 1) / threads, NULL, 0};
+    started[i] = i > 0 && pthread_create(&workers[i], NULL, indexRange, &ranges[i]) == 0;
+  }
+  size_t total = 0;
+  for (int i = 0; i < threads; i++) {
+    if (started[i]) {
+      pthread_join(workers[i], NULL);
+    } else {
+      indexRange(&ranges[i]);
+    }
+    total += ranges[i].count;
+  }
+  size_t *lines = realloc(ranges[0].lines, (total + 1) * sizeof(size_t));
+  size_t n = ranges[0].count;
+  for (int i = 1; i < threads; i++) {
+    memcpy(lines + n, ranges[i].lines, ranges[i].count * sizeof(size_t));
+    n += ranges[i].count;
+    free(ranges[i].lines);
+  }
+  // a newline at the very end doesn't start another line
+  if (n > 0 && lines[n - 1] == length) {
+    n--;
+  }
+  lines[n] = length;
+  *count = n;
+  return lines;
+}
+
+int indexThreads(size_t length) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t threads = length / LINES_PER_THREAD;
+  if (cpus > 0 && threads > (size_t)cpus) threads = cpus;
+  if (threads > LINES_MAX_THREADS) threads = LINES_MAX_THREADS;
+  return threads < 1 ? 1 : threads;
+}
+
+/**
+ * A row for the characters from start to end, leaving off the line ending.
+ */
+static EditorRow *lineRow(const char *start, const char *end, int tabSize) {
+  while (end > start && (end[-1] == '\n' || end[-1] == '\r')) {
+    end--;
+  }
+  return newRowCopy(start, end - start, tabSize);
+}
+
+EditorRow **readLines(int fileDescriptor, int tabSize, int64_t *count) {
+  size_t capacity = 1024;
+  EditorRow **rows = malloc(capacity * sizeof(EditorRow *));
+  size_t n = 0;
+  size_t size = READ_BLOCK;
+  char *block = malloc(size);
+  size_t *starts = malloc(size * sizeof(size_t));
+  // characters of a line that didn't end in the last block
+  size_t carried = 0;
+  ssize_t got;
+  while ((got = read(fileDescriptor, block + carried, size - carried)) > 0) {
+    size_t lines = splitLines(block + carried, got, carried, starts);
+    if (n + lines > capacity) {
+      while (n + lines > capacity) capacity *= 2;
+      rows = realloc(rows, capacity * sizeof(EditorRow *));
+    }
+    size_t start = 0;
+    for (size_t i = 0; i < lines; i++) {
+      rows[n++] = lineRow(block + start, block + starts[i], tabSize);
+      start = starts[i];
+    }
+    carried = carried + got - start;
+    memmove(block, block + start, carried);
+    if (carried == size) {
+      size *= 2;
+      block = realloc(block, size);
+      starts = realloc(starts, size * sizeof(size_t));
+    }
+  }
+  if (carried > 0) {
+    if (n == capacity) {
+      rows = realloc(rows, ++capacity * sizeof(EditorRow *));
+    }
+    rows[n++] = lineRow(block, block + carried, tabSize);
+  }
+  free(block);
+  free(starts);
+  *count = n;
+  return rows;
+}
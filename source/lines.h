@@ -0,0 +1,62 @@
+#ifndef LINES
+#define LINES
+
+#include <stddef.h>
+#include <stdint.h>
+#include "editorRow.h"
+
+/**
+ * Characters of text to give each thread when indexing lines. Starting a
+ * thread for less than this costs more than it saves.
+ */
+#define LINES_PER_THREAD (8 << 20)
+
+#define LINES_MAX_THREADS 64
+
+/**
+ * Ways of finding where lines start. Like TabKernels, there's a portable
+ * version, and on x86 ones using SSE2 and AVX2 which compare 16 or 32
+ * characters at a time and then pick the newlines out of the mask.
+ *
+ * name: For benchmarks and the like.
+ * split: For each '\n' in the first length characters of s, write base plus
+ *   the index of the character after it to starts, and return how many there
+ *   were. starts needs room for length entries.
+ */
+typedef struct LineKernels {
+  const char *name;
+  size_t (*split)(const char *s, size_t length, size_t base, size_t *starts);
+} LineKernels;
+
+extern const LineKernels scalarLineKernels;
+
+/**
+ * The fastest kernels this CPU supports, picked the first time it's called.
+ */
+const LineKernels *lineKernels(void);
+
+size_t splitLines(const char *s, size_t length, size_t base, size_t *starts);
+
+/**
+ * Where each line of the first length characters of s starts, followed by
+ * length. The text is split into one range per thread, and the ranges are
+ * scanned in parallel and stitched together in order. Sets count to the
+ * number of lines.
+ */
+size_t *indexLines(const char *s, size_t length, int threads, int64_t *count);
+
+/**
+ * How many threads indexLines should use for length characters: one for each
+ * LINES_PER_THREAD of them, up to the number of CPUs (and
+ * LINES_MAX_THREADS).
+ */
+int indexThreads(size_t length);
+
+/**
+ * Read everything from fileDescriptor a block at a time, and make a row for
+ * each line (without its line ending). Returns the rows, and sets count to
+ * how many there are.
+ */
+EditorRow **readLines(int fileDescriptor, int tabSize, int64_t *count);
+
+#endif
@@ -1,6 +0,0 @@
-#include "ListPaneRow.h"
-
-#define n 1
-#define a List(List(PaneRow))
-#define LinkedListImplementation
-#include "MakeLinkedList.h"
@@ -1,7 +0,0 @@
-#pragma once
-
-#include "ListPaneRow.h"
-
-#define n 1
-#define a List(List(PaneRow))
-#include "MakeLinkedList.h"
@@ -1,6 +0,0 @@
-#include "PaneRow.h"
-
-#define n 1
-#define a List(PaneRow)
-#define LinkedListImplementation
-#include "MakeLinkedList.h"
@@ -1,7 +0,0 @@
-#pragma once
-
-#include "PaneRow.h"
-
-#define n 1
-#define a List(PaneRow)
-#include "MakeLinkedList.h"
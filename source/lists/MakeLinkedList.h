@@ -3,6 +3,7 @@
 #ifdef a
 
 #include <stdlib.h>
+#include "../pool.h"
 
 #define _List(a) List__##a
 #define List(a) _List(a)
@@ -17,6 +18,14 @@ typedef struct List(a) {
     struct List(a) *tail;
 } List(a);
 
+/**
+ * The cells of every List(a) come from this pool.
+ */
+#define _ListPoolName(a) listPool__ ## a
+#define ListPoolName(a) _ListPoolName(a)
+
+extern Pool ListPoolName(a);
+
 #define _ListConsName(a) listCons__ ## a
 #define ListConsName(a) _ListConsName(a)
 
@@ -47,6 +56,15 @@ void ListFreeName(a)(List(a) *as);
 
 void ListFreeUntilName(a)(List(a) *as, List(a) *bs);
 
+/**
+ * Free every List(a) cell at once, in O(1). Only for list types whose cells
+ * are all temporary, like the ones that make up a frame.
+ */
+#define _ListFreeAllName(a) listFreeAll__ ## a
+#define ListFreeAllName(a) _ListFreeAllName(a)
+
+void ListFreeAllName(a)(void);
+
 typedef struct ListFT(a) {
     List(a) * (*cons)(a *, List(a) *);
     int (*length)(List(a) *);
@@ -54,14 +72,17 @@ typedef struct ListFT(a) {
     List(a) * (*concat)(List(a) *, List(a) *);
     void (*free)(List(a) *);
     void (*freeUntil)(List(a) *, List(a) *);
+    void (*freeAll)(void);
 } ListFT(a);
 
 extern ListFT(a) ListF(a);
 
 #ifdef LinkedListImplementation
 
+Pool ListPoolName(a) = POOL_INIT(List(a));
+
 List(a) *ListConsName(a)(a *head, List(a) *tail) {
-    List(a) *list = malloc(sizeof(List(a)));
+    List(a) *list = poolAlloc(&ListPoolName(a));
     list->head = head;
     list->tail = tail;
     return list;
@@ -96,7 +117,7 @@ void ListFreeName(a)(List(a) *as) {
     List (a) *current = as;
     while (current != NULL) {
         List(a) *next = current->tail;
-        free(current);
+        poolFree(&ListPoolName(a), current);
         current = next;
     }
 }
@@ -105,18 +126,23 @@ void ListFreeUntilName(a)(List(a) *as, List(a) *bs) {
     List(a) *current = as;
     while (current != NULL && current != bs) {
         List(a) *next = current->tail;
-        free(current);
+        poolFree(&ListPoolName(a), current);
         current = next;
     }
 }
 
+void ListFreeAllName(a)(void) {
+    poolReset(&ListPoolName(a));
+}
+
 ListFT(a) ListF(a) = {
     ListConsName(a),
     ListLengthName(a),
     ListReverseName(a),
     ListConcatName(a),
     ListFreeName(a),
-    ListFreeUntilName(a)
+    ListFreeUntilName(a),
+    ListFreeAllName(a)
 };
 
 #endif // LinkedListImplementation
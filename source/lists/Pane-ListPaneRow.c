@@ -1,9 +0,0 @@
-#include "../pane.h"
-#include "ListPane.h"
-#include "ListPaneRow.h"
-
-#define n 2
-#define a Pane
-#define b List(PaneRow)
-#define LinkedListImplementation
-#include "MakeLinkedList.h"
@@ -1,10 +0,0 @@
-#pragma once
-
-#include "../pane.h"
-#include "ListPane.h"
-#include "ListPaneRow.h"
-
-#define n 2
-#define a Pane
-#define b List(PaneRow)
-#include "MakeLinkedList.h"
@@ -1,11 +0,0 @@
-#include "Pane.h"
-#include "int.h"
-#include "ListListPaneRow.h"
-
-#define n 4
-#define a Pane
-#define b int
-#define c int
-#define d List(PaneRow)
-#define LinkedListImplementation
-#include "MakeLinkedList.h"
@@ -1,14 +0,0 @@
-#pragma once
-
-#include "../pane.h"
-#include "PaneRow.h"
-#include "int.h"
-#include "ListPaneRow.h"
-#include "ListPane.h"
-
-#define n 4
-#define a Pane
-#define b int
-#define c int
-#define d List(PaneRow)
-#include "MakeLinkedList.h"
@@ -1,6 +0,0 @@
-typedef struct PaneRow PaneRow;
-
-#define n 1
-#define a PaneRow
-#define LinkedListImplementation
-#include "MakeLinkedList.h"
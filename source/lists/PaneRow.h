@@ -1,7 +0,0 @@
-#pragma once
-
-typedef struct PaneRow PaneRow;
-
-#define n 1
-#define a PaneRow
-#include "MakeLinkedList.h"
@@ -0,0 +1,143 @@
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+#define HASH_BITS 12
+
+#define MIN_MATCH 4
+
+#define MAX_OFFSET 65535
+
+/**
+ * The last bytes are always literals, and no match starts in the last
+ * MATCH_LIMIT bytes, so that decompressors can copy in whole words.
+ */
+#define LAST_LITERALS 5
+#define MATCH_LIMIT 12
+
+static uint32_t read32(const unsigned char *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static int hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Write the part of a length that doesn't fit in its token: as many 255s as
+ * it takes, then the rest.
+ */
+static unsigned char *writeLength(unsigned char *out, size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = length;
+  return out;
+}
+
+/**
+ * Write a run of literals, and the match after it if there is one (a match
+ * length of MIN_MATCH or more).
+ */
+static unsigned char *writeSequence(unsigned char *out, const unsigned char *literals,
+                                    size_t length, size_t offset, size_t match) {
+  unsigned char *token = out++;
+  *token = (length < 15 ? length : 15) << 4;
+  if (length >= 15) out = writeLength(out, length - 15);
+  memcpy(out, literals, length);
+  out += length;
+  if (match < MIN_MATCH) return out;
+  match -= MIN_MATCH;
+  *token |= match < 15 ? match : 15;
+  *out++ = offset & 0xff;
+  *out++ = offset >> 8;
+  if (match >= 15) out = writeLength(out, match - 15);
+  return out;
+}
+
+size_t lzCompress(const char *input, size_t length, char *output) {
+  const unsigned char *in = (const unsigned char *)input;
+  unsigned char *out = (unsigned char *)output;
+  size_t anchor = 0;
+  if (length > MATCH_LIMIT) {
+    size_t seen[1 << HASH_BITS];
+    memset(seen, 0xff, sizeof(seen));
+    size_t limit = length - MATCH_LIMIT;
+    size_t i = 0;
+    while (i <= limit) {
+      uint32_t value = read32(in + i);
+      int h = hash(value);
+      size_t candidate = seen[h];
+      seen[h] = i;
+      if (candidate == SIZE_MAX || i - candidate > MAX_OFFSET ||
+          read32(in + candidate) != value) {
+        // skip ahead faster the longer it's been since the last match, so
+        // that incompressible data doesn't take long
+        i += 1 + ((i - anchor) >> 6);
+        continue;
+      }
+      size_t end = i + MIN_MATCH;
+      while (end < length - LAST_LITERALS && in[end] == in[end - i + candidate]) {
+        end++;
+      }
+      while (i > anchor && candidate > 0 && in[i - 1] == in[candidate - 1]) {
+        i--;
+        candidate--;
+      }
+      out = writeSequence(out, in + anchor, i - anchor, i - candidate, end - i);
+      i = anchor = end;
+    }
+  }
+  out = writeSequence(out, in + anchor, length - anchor, 0, 0);
+  return out - (unsigned char *)output;
+}
+
+/**
+ * Add the rest of a length that filled its token. Returns false if it runs
+ * off the end.
+ */
+static bool readLength(const unsigned char **in, const unsigned char *end,
+                       size_t *length) {
+  unsigned char byte;
+  do {
+    if (*in == end) return false;
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool lzDecompress(const char *input, size_t size, char *out, size_t length) {
+  const unsigned char *in = (const unsigned char *)input;
+  const unsigned char *end = in + size;
+  size_t at = 0;
+  while (in < end) {
+    unsigned token = *in++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !readLength(&in, end, &literals)) return false;
+    if (literals > (size_t)(end - in) || literals > length - at) return false;
+    memcpy(out + at, in, literals);
+    in += literals;
+    at += literals;
+    if (in == end) break;
+
+    if (end - in < 2) return false;
+    size_t offset = in[0] | in[1] << 8;
+    in += 2;
+    size_t match = token & 15;
+    if (match == 15 && !readLength(&in, end, &match)) return false;
+    match += MIN_MATCH;
+    if (offset == 0 || offset > at || match > length - at) return false;
+    if (offset >= match) {
+      memcpy(out + at, out + at - offset, match);
+    } else {
+      // the match overlaps what it's copying: a repeating pattern
+      for (size_t k = 0; k < match; k++) out[at + k] = out[at + k - offset];
+    }
+    at += match;
+  }
+  return at == length;
+}
@@ -0,0 +1,33 @@
+#ifndef LZ
+#define LZ
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Most bytes lzCompress can turn length bytes into (when there's nothing to
+ * compress, and everything is written as literals).
+ */
+#define LZ_BOUND(length) ((length) + (length) / 255 + 16)
+
+/**
+ * Compress the first length bytes of in into out, which needs room for
+ * LZ_BOUND(length) bytes, and return how many bytes that took.
+ *
+ * The format is LZ4's block format: a sequence of runs of literal bytes,
+ * each followed (except the last) by a match, a copy of at least 4 earlier
+ * bytes given by how far back they are (up to 64KB) and how many there are.
+ * Matches are found through a hash table of the last place each 4 bytes
+ * were seen, which is quick (a few hundred MB/s) and still finds most of
+ * the repetition in text, where lines tend to look like nearby lines.
+ */
+size_t lzCompress(const char *in, size_t length, char *out);
+
+/**
+ * Decompress the size bytes at in into out, which has room for exactly
+ * length bytes: what was compressed. Returns false if in is damaged, and
+ * never reads or writes outside the two.
+ */
+bool lzDecompress(const char *in, size_t size, char *out, size_t length);
+
+#endif
@@ -0,0 +1,125 @@
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "editorRow.h"
+#include "lines.h"
+#include "mappedFile.h"
+
+MappedFile *mappedFile(int fileDescriptor, int tabSize) {
+  struct stat status;
+  if (fstat(fileDescriptor, &status) == -1 || !S_ISREG(status.st_mode) ||
+      status.st_size == 0) {
+    return NULL;
+  }
+  void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+  if (data == MAP_FAILED) return NULL;
+  MappedFile *file = malloc(sizeof(MappedFile));
+  file->references = 1;
+  file->data = data;
+  file->size = status.st_size;
+  file->modified = status.st_mtim;
+  file->tabSize = tabSize;
+  file->lines = NULL;
+  file->count = 0;
+  file->indexed = 0;
+  file->saving = 0;
+  mappedFileIndex(file, mappedFileIndexChunk());
+  return file;
+}
+
+size_t mappedFileIndexChunk(void) {
+  size_t chunk = (size_t)indexThreads(SIZE_MAX) * LINES_PER_THREAD;
+  return chunk > MAPPED_FILE_INDEX_CHUNK ? chunk : MAPPED_FILE_INDEX_CHUNK;
+}
+
+/**
+ * The last newline in the first length characters of s, or NULL.
+ */
+static const char *lastNewline(const char *s, size_t length) {
+  while (length > 0) {
+    if (s[--length] == '\n') return s + length;
+  }
+  return NULL;
+}
+
+void mappedFileIndex(MappedFile *file, size_t bytes) {
+  size_t start = file->indexed;
+  if (start == file->size || file->saving > 0) return;
+  size_t end = bytes < file->size - start ? start + bytes : file->size;
+  // finish on the end of a line: cut back to the last newline, or if there
+  // isn't one, carry on to the next
+  if (end < file->size) {
+    const char *newline = lastNewline(file->data + start, end - start);
+    if (newline == NULL) newline = memchr(file->data + end, '\n', file->size - end);
+    end = newline == NULL ? file->size : (size_t)(newline - file->data) + 1;
+  }
+  int64_t count;
+  size_t *starts = indexLines(file->data + start, end - start, indexThreads(end - start), &count);
+  int64_t first = (file->count + LINE_INDEX_STRIDE - 1) / LINE_INDEX_STRIDE;
+  int64_t last = (file->count + count + LINE_INDEX_STRIDE - 1) / LINE_INDEX_STRIDE;
+  if (last > first) {
+    file->lines = realloc(file->lines, last * sizeof(size_t));
+    for (int64_t k = first; k < last; k++) {
+      file->lines[k] = start + starts[k * LINE_INDEX_STRIDE - file->count];
+    }
+  }
+  free(starts);
+  file->count += count;
+  file->indexed = end;
+  // the pages indexed won't be needed again until they're scrolled to
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t from = (start + page - 1) / page * page;
+  size_t to = end / page * page;
+  if (to > from) madvise(file->data + from, to - from, MADV_DONTNEED);
+}
+
+bool mappedFileIndexed(MappedFile *file) {
+  return file->indexed == file->size;
+}
+
+MappedFile *mappedFileRetain(MappedFile *file) {
+  if (file != NULL) file->references++;
+  return file;
+}
+
+void mappedFileRelease(MappedFile *file) {
+  if (file == NULL || --file->references > 0) return;
+  munmap(file->data, file->size);
+  free(file->lines);
+  free(file);
+}
+
+size_t mappedFileLineStart(MappedFile *file, int64_t line) {
+  size_t start = file->lines[line / LINE_INDEX_STRIDE];
+  for (int i = line % LINE_INDEX_STRIDE; i > 0; i--) {
+    start = (const char *)memchr(file->data + start, '\n', file->size - start) - file->data + 1;
+  }
+  return start;
+}
+
+const char *mappedFileLineAt(MappedFile *file, size_t start, size_t *length,
+                             size_t *next) {
+  const char *chars = file->data + start;
+  const char *newline = memchr(chars, '\n', file->size - start);
+  const char *end = newline == NULL ? file->data + file->size : newline;
+  *next = end - file->data + (newline != NULL);
+  while (end > chars && end[-1] == '\r') end--;
+  *length = end - chars;
+  return chars;
+}
+
+const char *mappedFileLine(MappedFile *file, int64_t line, size_t *length) {
+  size_t next;
+  return mappedFileLineAt(file, mappedFileLineStart(file, line), length, &next);
+}
+
+EditorRow *mappedFileRow(MappedFile *file, int64_t line) {
+  size_t length;
+  const char *chars = mappedFileLine(file, line, &length);
+  return newRowView(chars, length, file->tabSize);
+}
@@ -0,0 +1,117 @@
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "editorRow.h"
+
+/**
+ * Lines between the entries of a mapped file's line index.
+ */
+#define LINE_INDEX_STRIDE 64
+
+/**
+ * Fewest bytes of a mapped file indexed at a time (see mappedFileIndexChunk).
+ */
+#define MAPPED_FILE_INDEX_CHUNK (32 << 20)
+
+typedef struct MappedFile MappedFile;
+
+/**
+ * A file mapped into memory, and an index of where its lines start. Rows
+ * made from it point into the mapping rather than holding copies of their
+ * lines.
+ *
+ * Files can be bigger than memory, so neither the file nor the index is
+ * kept whole. Only the parts of the mapping in use are read in (and the
+ * kernel can drop them again, since they're never written to), and the
+ * index only has every LINE_INDEX_STRIDEth line: the lines in between are
+ * found by scanning on from there. The index is built a chunk at a time, so
+ * that the start of a big file can be shown before the rest has been read.
+ *
+ * references: Number of row tree leaves (and other holders) using the file.
+ *   The file is unmapped when the last one lets go.
+ * data, size: The mapping.
+ * modified: When the file was last modified, as it was mapped.
+ * lines: Offset of the start of lines 0, LINE_INDEX_STRIDE,
+ *   2 * LINE_INDEX_STRIDE, and so on.
+ * count: Number of lines indexed so far.
+ * indexed: Number of bytes indexed so far. Always the end of a line.
+ * saving: Number of saves of rows from the file that are running (see
+ *   saveInBackground). They read lines from another thread, so the index
+ *   isn't added to until they've finished.
+ */
+struct MappedFile {
+  int references;
+  char *data;
+  size_t size;
+  struct timespec modified;
+  size_t *lines;
+  int64_t count;
+  size_t indexed;
+  int saving;
+  int tabSize;
+};
+
+/**
+ * Map the file open on fileDescriptor and index its first chunk, or return
+ * NULL if it can't be mapped (it's empty, or isn't a regular file). The file
+ * descriptor is left open, and can still be read from if the file wasn't
+ * mapped.
+ */
+MappedFile *mappedFile(int fileDescriptor, int tabSize);
+
+/**
+ * Index at least the next bytes bytes of file (up to the end of a line),
+ * adding to count. Does nothing while the file is being saved (see saving).
+ */
+void mappedFileIndex(MappedFile *file, size_t bytes);
+
+/**
+ * Bytes of a mapped file to index at a time, when it's opened and then by
+ * each call to mappedFileIndex: enough for every CPU to get LINES_PER_THREAD
+ * of them (see indexThreads), so that a chunk keeps all of them busy, and at
+ * least MAPPED_FILE_INDEX_CHUNK.
+ */
+size_t mappedFileIndexChunk(void);
+
+/**
+ * Whether all of file has been indexed.
+ */
+bool mappedFileIndexed(MappedFile *file);
+
+MappedFile *mappedFileRetain(MappedFile *file);
+
+/**
+ * Give up a reference to file, unmapping it if that was the last one.
+ */
+void mappedFileRelease(MappedFile *file);
+
+/**
+ * Where the line at index line starts, found from the last indexed line
+ * before it.
+ */
+size_t mappedFileLineStart(MappedFile *file, int64_t line);
+
+/**
+ * The characters of the line starting at offset start, without its line
+ * ending (they're in the mapping, so they aren't followed by a '\0'). Sets
+ * length to how many there are, and next to where the next line starts.
+ */
+const char *mappedFileLineAt(MappedFile *file, size_t start, size_t *length,
+                             size_t *next);
+
+/**
+ * The characters of the line at index line, as mappedFileLineAt.
+ */
+const char *mappedFileLine(MappedFile *file, int64_t line, size_t *length);
+
+/**
+ * A new row for the line at index line, without its line ending. Its
+ * characters are in the mapping, so they aren't followed by a '\0'.
+ */
+EditorRow *mappedFileRow(MappedFile *file, int64_t line);
+
+#endif
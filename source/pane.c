@@ -1,89 +1,139 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include "editorRow.h"
-#include "lists/PaneRow.h"
 #include "pane.h"
+#include "rope.h"
 #include "util.h"
 #include "zipperBuffer.h"
 
-Pane *makePane(int cursorX, int cursorY, int top, int left, FileData *file) {
+Pane *makePane(int64_t cursorX, int64_t cursorY, int64_t top, int64_t left,
+               FileData *file) {
   Pane *p = malloc(sizeof(Pane));
   p->cursorX = cursorX;
   p->cursorY = cursorY;
   p->top = top;
   p->left = left;
+  p->drawnTop = top;
   p->file = file;
+  p->status = NULL;
+  p->statusCapacity = 0;
+  p->statusKey = (StatusKey){NULL, 0, 0, false, false, 0};
   return p;
 }
 
-List(PaneRow) *drawRow(int left, int width, EditorRow *r) {
-  int x = clip(left, 0, r->renderSize);
-  int resultWidth = clip(r->renderSize - x, 0, width);
-  unsigned int blanks = width - resultWidth;
-  return ListF(PaneRow).cons(makePaneRow(r->renderChars + x, resultWidth, blanks), NULL);
+PaneRow drawRow(int64_t left, int width, EditorRow *r) {
+  int64_t renderSize = editorRowRenderSize(r);
+  int64_t x = clip(left, 0, renderSize);
+  int resultWidth = clip(renderSize - x, 0, width);
+  return (PaneRow){editorRowRender(r) + x, resultWidth, width - resultWidth, false};
 }
 
-List(PaneRow) *drawPane(int height, int left, int width, PaneRow *status, RowList *rows) {
-  if (height <= 0) {
-    return NULL;
-  } else if (height == 1) {
-    return ListF(PaneRow).cons(status, NULL);
-  } else if (rows == NULL) {
-    List(PaneRow) *head = ListF(PaneRow).cons(
-      makePaneRow("", width, width),
-      drawPane(height - 1, left, width, status, NULL)
-    );
-    return head;
-  } else {
-    List(PaneRow) *head = drawRow(left, width, rows->head);
-    List(PaneRow) *tail = drawPane(height - 1, left, width, status, rows->tail);
-    head->tail = tail;
-    return head;
+/**
+ * Draw a row that's being edited, straight from its gap buffer into text
+ * (which has room for width characters).
+ */
+static PaneRow drawOpenRow(int64_t left, int width, GapBuffer *gap, char *text) {
+  int resultWidth = gapRender(gap, left, width, text);
+  return (PaneRow){text, resultWidth, width - resultWidth, false};
+}
+
+/**
+ * Draw the lines of a buffer whose text is in a rope, rendering each one
+ * into its own width characters of text.
+ */
+static void drawRopeLines(Pane *p, int lines, int width, PaneRow *rows, int stride,
+                          char *text) {
+  ZipperBuffer *buffer = p->file->buffer;
+  int64_t length = zipperLength(buffer);
+  size_t start = ropeLineStart(buffer->rope, p->top);
+  for (int i = 0; i < lines; i++) {
+    PaneRow *paneRow = &rows[(size_t)i * stride];
+    if (p->top + i >= length) {
+      *paneRow = (PaneRow){"", 0, width, false};
+      continue;
+    }
+    char *line = text + (size_t)i * width;
+    int resultWidth = ropeRender(buffer->rope, start, p->left, width, buffer->tabSize,
+                                 line, &start);
+    *paneRow = (PaneRow){line, resultWidth, width - resultWidth, false};
   }
 }
 
-List(PaneRow) *paneDraw(Pane *p, int *height, int *width) {
-  RowList *rows = zipperRowsFrom(p->file->buffer, p->file->cursorY, p->top);
-  return drawPane(*height, p->left, *width, drawStatusBar(p, *width), rows);
+void paneDraw(Pane *p, int height, int width, PaneRow *rows, int stride, char *text) {
+  if (height <= 0) {
+    return;
+  }
+  ZipperBuffer *buffer = p->file->buffer;
+  if (zipperIsRope(buffer)) {
+    drawRopeLines(p, height - 1, width, rows, stride, text);
+    rows[(size_t)(height - 1) * stride] = drawStatusBar(p, width);
+    return;
+  }
+  RowIterator iterator = zipperRowsFrom(buffer, p->top);
+  // how many rows down the row that's being edited is, if it's in the pane
+  int64_t open = zipperRowIsOpen(buffer) ? buffer->cursor - p->top : -1;
+  for (int i = 0; i < height - 1; i++) {
+    EditorRow *row = rowIteratorNext(&iterator);
+    PaneRow *paneRow = &rows[(size_t)i * stride];
+    if (row == NULL) {
+      *paneRow = (PaneRow){"", 0, width, false};
+    } else if (i == open) {
+      *paneRow = drawOpenRow(p->left, width, buffer->open, text);
+    } else {
+      *paneRow = drawRow(p->left, width, row);
+    }
+  }
+  rows[(size_t)(height - 1) * stride] = drawStatusBar(p, width);
 }
 
-PaneRow *drawStatusBar(Pane *p, int width) {
-  int bufferWidth = width + 4 + 5 + 1;
-  char *status = malloc(bufferWidth);
-  snprintf(status, 5, "\x1b[7m");
-  int leftLength = snprintf(
-    status + 4,
-    width + 1,
-    "\"%.20s\" - %d lines %s",
-    p->file->filename ? p->file->filename : "[No name]",
+PaneRow drawStatusBar(Pane *p, int width) {
+  if (width < 0) width = 0;
+  StatusKey key = {
+    p->file->filename,
     p->file->numberOfRows,
-    p->file->unsavedChanges ? "(modified)" : ""
+    p->cursorY,
+    p->file->indexing != NULL,
+    p->file->unsavedChanges != 0,
+    width
+  };
+  StatusKey *drawn = &p->statusKey;
+  if (p->status != NULL && key.filename == drawn->filename
+      && key.numberOfRows == drawn->numberOfRows && key.cursorY == drawn->cursorY
+      && key.indexing == drawn->indexing && key.modified == drawn->modified
+      && key.width == drawn->width) {
+    return (PaneRow){p->status, width, 0, true};
+  }
+
+  if (p->status == NULL || p->statusCapacity < width) {
+    free(p->status);
+    p->status = malloc(width + 1);
+    p->statusCapacity = width;
+  }
+  char left[80];
+  int leftLength = snprintf(
+    left,
+    sizeof(left),
+    "\"%.20s\" - %" PRId64 "%s lines %s",
+    key.filename ? key.filename : "[No name]",
+    key.numberOfRows,
+    key.indexing ? "+" : "",
+    key.modified ? "(modified)" : ""
   );
-  char *rightStatus = malloc(bufferWidth);
+  char right[48];
   int rightLength = snprintf(
-    rightStatus,
-    width + 1,
-    "%d/%d",
-    p->cursorY + 1,
-    p->file->numberOfRows
+    right,
+    sizeof(right),
+    "%" PRId64 "/%" PRId64,
+    key.cursorY + 1,
+    key.numberOfRows
   );
-  snprintf(rightStatus + width, 6, "\x1b[27m");
-  int numberOfBlanks = width - (leftLength + rightLength);
-  for (int i = leftLength + 4; i < leftLength + 4 + numberOfBlanks; i++) {
-    status[i] = ' ';
-  }
-  snprintf(
-    status + leftLength + 4 + numberOfBlanks,
-    rightLength + 5 + 1,
-    "%s",
-    rightStatus
-  );
-  free(rightStatus);
-  return makePaneRow(status, width, 0);
-}
-
-PaneRow *makePaneRow(char *row, int width, unsigned int blanks) {
-  PaneRow *r = malloc(sizeof(PaneRow));
-  r->row = row;
-  r->width = width;
-  r->blanks = blanks;
-  return r;
+  // the right side wins if there isn't room for both
+  if (rightLength > width) rightLength = width;
+  if (leftLength > width - rightLength) leftLength = width - rightLength;
+  memcpy(p->status, left, leftLength);
+  memset(p->status + leftLength, ' ', width - leftLength - rightLength);
+  memcpy(p->status + width - rightLength, right, rightLength);
+  *drawn = key;
+  return (PaneRow){p->status, width, 0, true};
 }
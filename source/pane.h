@@ -1,6 +1,6 @@
 #pragma once
+#include <stdbool.h>
 #include "fileData.h"
-#include "lists/PaneRow.h"
 #include "zipperBuffer.h"
 
 /**
@@ -12,28 +12,70 @@
  * top: top of pane starts this many lines from the top of the buffer
  * left: left of pane starts this many characters from the left of the
  *   buffer
+ * drawnTop: What top was when the pane was last laid out (see
+ *   drawDisplayColumn), so the frame after a scroll knows how far it went.
+ * status: The status bar as it was last drawn, statusKey.width characters
+ *   (with room for statusCapacity), or NULL if it hasn't been yet.
+ * statusKey: What status was drawn from. The bar is only drawn again when
+ *   one of these changes.
  */
+typedef struct StatusKey {
+  const char *filename;
+  int64_t numberOfRows;
+  int64_t cursorY;
+  bool indexing;
+  bool modified;
+  int width;
+} StatusKey;
+
 typedef struct Pane {
-  int cursorX;
-  int cursorY;
-  int top;
-  int left;
+  int64_t cursorX;
+  int64_t cursorY;
+  int64_t top;
+  int64_t left;
+  int64_t drawnTop;
   FileData *file;
+  char *status;
+  int statusCapacity;
+  StatusKey statusKey;
 } Pane;
 
-Pane *makePane(int cursorX, int cursorY, int top, int left, FileData *file);
+Pane *makePane(int64_t cursorX, int64_t cursorY, int64_t top, int64_t left,
+               FileData *file);
 
+/**
+ * What a pane shows on one line: width characters of row, then blanks
+ * spaces, in reverse video if reverse is set.
+ */
 typedef struct PaneRow {
   char *row;
   int width;
   /** The number of blanks needed to the right of the line. */
   int blanks;
+  bool reverse;
 } PaneRow;
 
-PaneRow *makePaneRow(char *row, int width, unsigned int blanks);
+/**
+ * Room paneDraw needs, for a pane height high and width wide, for the text
+ * it draws that isn't part of a row: the onscreen part of the row that's
+ * being edited, or of every line if the buffer's text is in a rope.
+ */
+#define PANE_TEXT_SIZE(height, width) ((size_t)(height) * (width))
 
-PaneRow *drawStatusBar(Pane *p, int width);
+/**
+ * p's status bar, width wide. It's kept in the pane and only drawn again
+ * (two snprintfs) when what it shows has changed, so the row lasts until
+ * the next call.
+ */
+PaneRow drawStatusBar(Pane *p, int width);
 
-List(PaneRow) *paneDraw(Pane *p, int *height, int *width);
+/**
+ * Lay out the height lines of p, width wide, into rows[0], rows[stride],
+ * rows[2 * stride] and so on, with the status bar on the last line. Text
+ * that isn't part of a row goes in text, which has room for
+ * PANE_TEXT_SIZE(height, width) characters. The PaneRows point into rows, text or
+ * the pane's status bar, and last until one of them changes.
+ */
+void paneDraw(Pane *p, int height, int width, PaneRow *rows, int stride, char *text);
 
-List(PaneRow) *drawRow(int left, int width, EditorRow *r);
+PaneRow drawRow(int64_t left, int width, EditorRow *r);
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include "pool.h"
+
+/**
+ * A block of cells. The header takes up a whole cache line so that the cells
+ * after it start on one.
+ */
+struct PoolSlab {
+  PoolSlab *next;
+  size_t cells;
+  _Alignas(POOL_CACHE_LINE) char data[];
+};
+
+size_t poolCellSize(Pool *pool) {
+  size_t size = pool->size < sizeof(void *) ? sizeof(void *) : pool->size;
+  if (size > POOL_CACHE_LINE) {
+    return (size + POOL_CACHE_LINE - 1) / POOL_CACHE_LINE * POOL_CACHE_LINE;
+  }
+  size_t rounded = sizeof(void *);
+  while (rounded < size) {
+    rounded *= 2;
+  }
+  return rounded;
+}
+
+static PoolSlab *newSlab(size_t cellSize) {
+  PoolSlab *slab = aligned_alloc(POOL_CACHE_LINE, POOL_SLAB_SIZE);
+  if (slab == NULL) abort();
+  slab->next = NULL;
+  slab->cells = (POOL_SLAB_SIZE - sizeof(PoolSlab)) / cellSize;
+  if (slab->cells == 0) abort();
+  return slab;
+}
+
+void *poolAlloc(Pool *pool) {
+  if (pool->free != NULL) {
+    void *cell = pool->free;
+    pool->free = *(void **)cell;
+    return cell;
+  }
+  size_t cellSize = poolCellSize(pool);
+  if (pool->current == NULL || pool->used == pool->current->cells) {
+    if (pool->current != NULL && pool->current->next != NULL) {
+      pool->current = pool->current->next;
+    } else if (pool->current == NULL && pool->slabs != NULL) {
+      pool->current = pool->slabs;
+    } else {
+      PoolSlab *slab = newSlab(cellSize);
+      if (pool->current == NULL) {
+        pool->slabs = slab;
+      } else {
+        pool->current->next = slab;
+      }
+      pool->current = slab;
+    }
+    pool->used = 0;
+  }
+  return pool->current->data + cellSize * pool->used++;
+}
+
+void poolFree(Pool *pool, void *cell) {
+  if (cell == NULL) return;
+  *(void **)cell = pool->free;
+  pool->free = cell;
+}
+
+void poolReset(Pool *pool) {
+  pool->current = NULL;
+  pool->used = 0;
+  pool->free = NULL;
+}
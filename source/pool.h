@@ -0,0 +1,64 @@
+#ifndef POOL
+#define POOL
+
+#include <stddef.h>
+
+/**
+ * Size of the blocks a pool carves its cells from.
+ */
+#define POOL_SLAB_SIZE (64 * 1024)
+
+#define POOL_CACHE_LINE 64
+
+typedef struct PoolSlab PoolSlab;
+
+/**
+ * Allocator for many small cells of one fixed size, e.g. list cells. Cells are
+ * carved in order out of cache-line-aligned slabs, so cells made one after the
+ * other (like the cells of a list) sit next to each other in memory. Freed
+ * cells go on a free list and are handed out again before new ones are
+ * carved.
+ *
+ * Cells are rounded up so that they never straddle a cache line: small cells
+ * to a power of two that divides the line, bigger ones to whole lines.
+ *
+ * size: Size of the type the pool holds; see POOL_INIT.
+ * slabs: Every slab the pool has, in the order they were made.
+ * current: The slab cells are being carved from, or NULL before the first
+ *   allocation.
+ * used: Number of cells carved from current so far.
+ * free: Cells that were freed, linked through their first word.
+ */
+typedef struct Pool {
+  size_t size;
+  PoolSlab *slabs;
+  PoolSlab *current;
+  size_t used;
+  void *free;
+} Pool;
+
+/**
+ * Initialiser for an empty pool of type, e.g.
+ * Pool nodes = POOL_INIT(RowTree);
+ */
+#define POOL_INIT(type) {sizeof(type), NULL, NULL, 0, NULL}
+
+void *poolAlloc(Pool *pool);
+
+/**
+ * Give a cell from poolAlloc back to the pool.
+ */
+void poolFree(Pool *pool, void *cell);
+
+/**
+ * Free every cell of the pool at once, in O(1). The slabs are kept and carved
+ * from again, so any cell still in use is overwritten by later allocations.
+ */
+void poolReset(Pool *pool);
+
+/**
+ * Size the pool gives each cell.
+ */
+size_t poolCellSize(Pool *pool);
+
+#endif
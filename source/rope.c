@@ -0,0 +1,408 @@
+#include <stdlib.h>
+#include <string.h>
+#include "mappedFile.h"
+#include "rope.h"
+
+static size_t countNewlines(const char *s, size_t length) {
+  size_t newlines = 0;
+  const char *end = s + length;
+  while ((s = memchr(s, '\n', end - s)) != NULL) {
+    newlines++;
+    s++;
+  }
+  return newlines;
+}
+
+static int height(Rope *rope) {
+  return rope == NULL ? -1 : rope->height;
+}
+
+/**
+ * New text with room for length bytes in chars, and no references yet.
+ */
+static RopeText *newText(size_t length) {
+  RopeText *block = malloc(sizeof(RopeText) + length);
+  block->references = 0;
+  block->file = NULL;
+  return block;
+}
+
+static void releaseText(RopeText *block) {
+  if (--block->references > 0) return;
+  mappedFileRelease(block->file);
+  free(block);
+}
+
+/*
+ * The helpers below take over the references to the ropes they're given,
+ * and return a new reference, so that a node that's taken apart and put back
+ * together is never copied when nothing else holds it.
+ */
+
+static Rope *leaf(RopeText *block, const char *text, size_t length) {
+  Rope *rope = malloc(sizeof(Rope));
+  rope->references = 1;
+  rope->length = length;
+  rope->newlines = countNewlines(text, length);
+  rope->height = 0;
+  rope->block = block;
+  block->references++;
+  rope->text = text;
+  rope->left = NULL;
+  rope->right = NULL;
+  return rope;
+}
+
+static Rope *branch(Rope *left, Rope *right) {
+  Rope *rope = malloc(sizeof(Rope));
+  rope->references = 1;
+  rope->length = left->length + right->length;
+  rope->newlines = left->newlines + right->newlines;
+  rope->height = 1 + (left->height > right->height ? left->height : right->height);
+  rope->block = NULL;
+  rope->text = NULL;
+  rope->left = left;
+  rope->right = right;
+  return rope;
+}
+
+/**
+ * Take a branch apart into references to its children.
+ */
+static void children(Rope *rope, Rope **left, Rope **right) {
+  *left = ropeRetain(rope->left);
+  *right = ropeRetain(rope->right);
+  ropeRelease(rope);
+}
+
+/**
+ * A branch with these children, rotated if their heights are more than one
+ * apart (which they can be by at most two).
+ */
+static Rope *balanced(Rope *left, Rope *right) {
+  Rope *a;
+  Rope *b;
+  Rope *c;
+  Rope *d;
+  if (height(left) > height(right) + 1) {
+    children(left, &a, &b);
+    if (height(a) >= height(b)) return branch(a, branch(b, right));
+    children(b, &c, &d);
+    return branch(branch(a, c), branch(d, right));
+  }
+  if (height(right) > height(left) + 1) {
+    children(right, &a, &b);
+    if (height(b) >= height(a)) return branch(branch(left, a), b);
+    children(a, &c, &d);
+    return branch(branch(left, c), branch(d, b));
+  }
+  return branch(left, right);
+}
+
+static Rope *concat(Rope *left, Rope *right) {
+  if (left == NULL) return right;
+  if (right == NULL) return left;
+  if (left->height == 0 && right->height == 0 &&
+      left->length + right->length <= ROPE_LEAF) {
+    RopeText *block = newText(left->length + right->length);
+    memcpy(block->chars, left->text, left->length);
+    memcpy(block->chars + left->length, right->text, right->length);
+    Rope *rope = leaf(block, block->chars, left->length + right->length);
+    ropeRelease(left);
+    ropeRelease(right);
+    return rope;
+  }
+  Rope *a;
+  Rope *b;
+  if (left->height > right->height + 1) {
+    children(left, &a, &b);
+    return balanced(a, concat(b, right));
+  }
+  if (right->height > left->height + 1) {
+    children(right, &a, &b);
+    return balanced(concat(left, a), b);
+  }
+  return branch(left, right);
+}
+
+static void split(Rope *rope, size_t at, Rope **left, Rope **right) {
+  Rope *a;
+  Rope *b;
+  Rope *rest;
+  if (rope == NULL || at == 0) {
+    *left = NULL;
+    *right = rope;
+  } else if (at >= rope->length) {
+    *left = rope;
+    *right = NULL;
+  } else if (rope->height == 0) {
+    *left = leaf(rope->block, rope->text, at);
+    *right = leaf(rope->block, rope->text + at, rope->length - at);
+    ropeRelease(rope);
+  } else {
+    children(rope, &a, &b);
+    if (at <= a->length) {
+      split(a, at, left, &rest);
+      *right = concat(rest, b);
+    } else {
+      split(b, at - a->length, &rest, right);
+      *left = concat(a, rest);
+    }
+  }
+}
+
+Rope *ropeRetain(Rope *rope) {
+  if (rope != NULL) rope->references++;
+  return rope;
+}
+
+void ropeRelease(Rope *rope) {
+  while (rope != NULL && --rope->references == 0) {
+    Rope *right = rope->right;
+    if (rope->height == 0) {
+      releaseText(rope->block);
+    } else {
+      ropeRelease(rope->left);
+    }
+    free(rope);
+    // the right child without recursing, so a long spine doesn't use stack
+    rope = right;
+  }
+}
+
+/**
+ * A balanced tree of leaves over length bytes of text.
+ */
+static Rope *fromLeaves(RopeText *block, const char *text, size_t length,
+                        size_t leaves) {
+  if (leaves == 1) return leaf(block, text, length);
+  size_t half = leaves / 2;
+  size_t split = length / leaves * half;
+  return branch(fromLeaves(block, text, split, half),
+                fromLeaves(block, text + split, length - split, leaves - half));
+}
+
+Rope *ropeFromString(const char *s, size_t length) {
+  if (length == 0) return NULL;
+  RopeText *block = newText(length);
+  memcpy(block->chars, s, length);
+  return fromLeaves(block, block->chars, length, (length + ROPE_LEAF - 1) / ROPE_LEAF);
+}
+
+Rope *ropeFromMappedFile(MappedFile *file) {
+  if (file->size == 0) return NULL;
+  RopeText *block = newText(0);
+  block->file = mappedFileRetain(file);
+  return fromLeaves(block, file->data, file->size,
+                    (file->size + ROPE_MAPPED_LEAF - 1) / ROPE_MAPPED_LEAF);
+}
+
+size_t ropeLength(Rope *rope) {
+  return rope == NULL ? 0 : rope->length;
+}
+
+size_t ropeLines(Rope *rope) {
+  return rope == NULL ? 1 : rope->newlines + 1;
+}
+
+Rope *ropeConcat(Rope *left, Rope *right) {
+  return concat(ropeRetain(left), ropeRetain(right));
+}
+
+void ropeSplit(Rope *rope, size_t at, Rope **left, Rope **right) {
+  split(ropeRetain(rope), at, left, right);
+}
+
+Rope *ropeInsert(Rope *rope, size_t at, const char *s, size_t length) {
+  if (length == 0) return ropeRetain(rope);
+  Rope *left;
+  Rope *right;
+  split(ropeRetain(rope), at, &left, &right);
+  return concat(concat(left, ropeFromString(s, length)), right);
+}
+
+Rope *ropeDelete(Rope *rope, size_t at, size_t length) {
+  if (length == 0) return ropeRetain(rope);
+  Rope *left;
+  Rope *middle;
+  Rope *right;
+  split(ropeRetain(rope), at, &left, &middle);
+  split(middle, length, &middle, &right);
+  ropeRelease(middle);
+  return concat(left, right);
+}
+
+Rope *ropeSubstring(Rope *rope, size_t at, size_t length) {
+  Rope *middle;
+  Rope *rest;
+  split(ropeRetain(rope), at, &rest, &middle);
+  ropeRelease(rest);
+  split(middle, length, &middle, &rest);
+  ropeRelease(rest);
+  return middle;
+}
+
+RopeIterator ropeIterate(Rope *rope, size_t at) {
+  RopeIterator iterator;
+  iterator.depth = 0;
+  iterator.skip = 0;
+  if (rope == NULL || at >= rope->length) return iterator;
+  while (rope->height > 0) {
+    if (at < rope->left->length) {
+      iterator.stack[iterator.depth++] = rope->right;
+      rope = rope->left;
+    } else {
+      at -= rope->left->length;
+      rope = rope->right;
+    }
+  }
+  iterator.stack[iterator.depth++] = rope;
+  iterator.skip = at;
+  return iterator;
+}
+
+const char *ropeIteratorNext(RopeIterator *iterator, size_t *length) {
+  if (iterator->depth == 0) return NULL;
+  Rope *rope = iterator->stack[--iterator->depth];
+  while (rope->height > 0) {
+    iterator->stack[iterator->depth++] = rope->right;
+    rope = rope->left;
+  }
+  const char *text = rope->text + iterator->skip;
+  *length = rope->length - iterator->skip;
+  iterator->skip = 0;
+  return text;
+}
+
+size_t ropeCopy(Rope *rope, size_t at, size_t length, char *destination) {
+  size_t copied = 0;
+  size_t chunkLength;
+  const char *chunk;
+  RopeIterator iterator = ropeIterate(rope, at);
+  while (copied < length && (chunk = ropeIteratorNext(&iterator, &chunkLength)) != NULL) {
+    if (chunkLength > length - copied) {
+      chunkLength = length - copied;
+    }
+    memcpy(destination + copied, chunk, chunkLength);
+    copied += chunkLength;
+  }
+  return copied;
+}
+
+int ropeIndex(Rope *rope, size_t at) {
+  if (rope == NULL || at >= rope->length) return -1;
+  while (rope->height > 0) {
+    if (at < rope->left->length) {
+      rope = rope->left;
+    } else {
+      at -= rope->left->length;
+      rope = rope->right;
+    }
+  }
+  return (unsigned char)rope->text[at];
+}
+
+/**
+ * Offset of the nth '\n' (counting from 1), or the length of the rope if
+ * there are fewer than n.
+ */
+static size_t newlineOffset(Rope *rope, size_t n) {
+  if (rope == NULL || n == 0 || n > rope->newlines) return ropeLength(rope);
+  size_t offset = 0;
+  while (rope->height > 0) {
+    if (n <= rope->left->newlines) {
+      rope = rope->left;
+    } else {
+      n -= rope->left->newlines;
+      offset += rope->left->length;
+      rope = rope->right;
+    }
+  }
+  const char *s = rope->text;
+  for (;;) {
+    s = memchr(s, '\n', rope->text + rope->length - s);
+    if (--n == 0) break;
+    s++;
+  }
+  return offset + (s - rope->text);
+}
+
+size_t ropeLineStart(Rope *rope, size_t line) {
+  if (line == 0) return 0;
+  if (rope == NULL || line > rope->newlines) return ropeLength(rope);
+  return newlineOffset(rope, line) + 1;
+}
+
+size_t ropeLineEnd(Rope *rope, size_t line) {
+  return newlineOffset(rope, line + 1);
+}
+
+/**
+ * Byte offset of a line and column, with the column clipped to the line.
+ */
+static size_t offsetOf(Rope *rope, size_t line, size_t column) {
+  size_t start = ropeLineStart(rope, line);
+  size_t end = ropeLineEnd(rope, line);
+  return column > end - start ? end : start + column;
+}
+
+Rope *ropeInsertChar(Rope *rope, size_t line, size_t column, int c) {
+  char s = c;
+  return ropeInsert(rope, offsetOf(rope, line, column), &s, 1);
+}
+
+Rope *ropeDeleteChar(Rope *rope, size_t line, size_t column) {
+  size_t at = offsetOf(rope, line, column);
+  if (at == 0) return ropeRetain(rope);
+  return ropeDelete(rope, at - 1, 1);
+}
+
+Rope *ropeInsertNewline(Rope *rope, size_t line, size_t column) {
+  return ropeInsertChar(rope, line, column, '\n');
+}
+
+int64_t ropeCursorToRender(Rope *rope, size_t start, size_t at, int tabSize) {
+  int64_t column = at;
+  size_t chunkLength;
+  const char *chunk;
+  RopeIterator iterator = ropeIterate(rope, start);
+  while (at > 0 && (chunk = ropeIteratorNext(&iterator, &chunkLength)) != NULL) {
+    if (chunkLength > at) chunkLength = at;
+    for (const char *tab = chunk; (tab = memchr(tab, '\t', chunk + chunkLength - tab)) != NULL;
+         tab++) {
+      column += tabSize - 1;
+    }
+    at -= chunkLength;
+  }
+  return column;
+}
+
+int ropeRender(Rope *rope, size_t start, int64_t left, int width, int tabSize,
+               char *out, size_t *next) {
+  int64_t column = 0;
+  int n = 0;
+  *next = start;
+  size_t chunkLength;
+  const char *chunk;
+  RopeIterator iterator = ropeIterate(rope, start);
+  while ((chunk = ropeIteratorNext(&iterator, &chunkLength)) != NULL) {
+    const char *end = memchr(chunk, '\n', chunkLength);
+    size_t length = end == NULL ? chunkLength : (size_t)(end - chunk);
+    // once out is full, the rest of the line is only looked through for its end
+    for (size_t i = 0; i < length && n < width; i++) {
+      int w = chunk[i] == '\t' ? tabSize : 1;
+      for (int k = 0; k < w && n < width; k++) {
+        if (column + k >= left) {
+          out[n++] = chunk[i] == '\t' || chunk[i] == '\r' ? ' ' : chunk[i];
+        }
+      }
+      column += w;
+    }
+    *next += length;
+    if (end != NULL) {
+      (*next)++;
+      break;
+    }
+  }
+  return n;
+}
@@ -0,0 +1,202 @@
+#ifndef ROPE
+#define ROPE
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mappedFile.h"
+
+/**
+ * Leaves built from a string hold this many bytes. Edits leave smaller leaves
+ * behind, and neighbouring leaves are copied together when they'd fit in one.
+ */
+#define ROPE_LEAF 1024
+
+/**
+ * Leaves built from a mapped file view this many bytes of the mapping, so that
+ * a file of hundreds of megabytes is a tree of thousands of leaves rather than
+ * hundreds of thousands, and nothing is copied when it's opened.
+ */
+#define ROPE_MAPPED_LEAF (64 << 10)
+
+/**
+ * Plenty for an AVL tree with one leaf per byte of a 64-bit address space.
+ */
+#define ROPE_MAX_HEIGHT 96
+
+typedef struct Rope Rope;
+
+typedef struct RopeText RopeText;
+
+/**
+ * Immutable bytes that leaves are slices of: either a copy, held in chars, or
+ * a mapped file.
+ *
+ * references: Number of leaves pointing into the text. It's freed (or the
+ *   file let go of) when the last one is.
+ * file: The mapped file the text is in, or NULL if it's in chars.
+ */
+struct RopeText {
+  int references;
+  MappedFile *file;
+  char chars[];
+};
+
+/**
+ * A persistent string, as an AVL tree whose leaves are slices of immutable
+ * text. Like RowTree, nothing reachable from a rope is ever changed: edits
+ * return a new rope that shares everything but the path to the edit with the
+ * old one, and leaves made by splitting point into the same text as the leaf
+ * they came from. The empty rope is NULL.
+ *
+ * Nodes and text are reference counted, and freed once nothing holds them.
+ * Every operation that returns a rope returns a new reference, which the
+ * caller gives up with ropeRelease; the rope passed in is left as it was.
+ *
+ * references: Number of parents and other holders (buffers, undo entries,
+ *   saves) pointing at this node.
+ * length: Number of bytes.
+ * newlines: Number of '\n' bytes, used to find lines.
+ * height: 0 for a leaf, otherwise one more than the taller child.
+ * block, text: For a leaf, the text it's a slice of, and where the slice
+ *   starts (it isn't null-terminated).
+ * left, right: For a branch, its children.
+ */
+struct Rope {
+  int references;
+  size_t length;
+  size_t newlines;
+  int height;
+  RopeText *block;
+  const char *text;
+  Rope *left;
+  Rope *right;
+};
+
+/**
+ * Take another reference to rope, and return it.
+ */
+Rope *ropeRetain(Rope *rope);
+
+/**
+ * Give up a reference to rope, freeing the nodes and text only it held.
+ */
+void ropeRelease(Rope *rope);
+
+/**
+ * Copy length bytes of s into a new rope, in O(length).
+ */
+Rope *ropeFromString(const char *s, size_t length);
+
+/**
+ * A rope of all of file, whose leaves point into the mapping (and hold a
+ * reference to file). Only the newlines are counted, not the lines indexed.
+ */
+Rope *ropeFromMappedFile(MappedFile *file);
+
+size_t ropeLength(Rope *rope);
+
+/**
+ * Number of lines, counting the text after the last '\n' (even if it's
+ * empty) as a line.
+ */
+size_t ropeLines(Rope *rope);
+
+Rope *ropeConcat(Rope *left, Rope *right);
+
+/**
+ * Split a rope into the first at bytes and the rest.
+ */
+void ropeSplit(Rope *rope, size_t at, Rope **left, Rope **right);
+
+/**
+ * A new rope with the bytes in s inserted before the byte at.
+ */
+Rope *ropeInsert(Rope *rope, size_t at, const char *s, size_t length);
+
+/**
+ * A new rope without the length bytes starting at at.
+ */
+Rope *ropeDelete(Rope *rope, size_t at, size_t length);
+
+/**
+ * The length bytes starting at at, sharing the text of rope.
+ */
+Rope *ropeSubstring(Rope *rope, size_t at, size_t length);
+
+/**
+ * Copy up to length bytes starting at at into destination, returning the
+ * number copied.
+ */
+size_t ropeCopy(Rope *rope, size_t at, size_t length, char *destination);
+
+/**
+ * The byte at, or -1 if it's out of range.
+ */
+int ropeIndex(Rope *rope, size_t at);
+
+/**
+ * Offset of the first byte of line (counting from 0), or the length of the
+ * rope if there aren't that many lines.
+ */
+size_t ropeLineStart(Rope *rope, size_t line);
+
+/**
+ * Offset of the '\n' ending line, or the length of the rope for the last
+ * line.
+ */
+size_t ropeLineEnd(Rope *rope, size_t line);
+
+/**
+ * Position in a rope, as the path of branches still to visit. Lives on the
+ * stack, so reading a rope doesn't allocate (or touch reference counts, so a
+ * rope can be read from another thread while it's held).
+ */
+typedef struct RopeIterator {
+  int depth;
+  Rope *stack[ROPE_MAX_HEIGHT];
+  size_t skip;
+} RopeIterator;
+
+/**
+ * An iterator whose first chunk starts at byte at.
+ */
+RopeIterator ropeIterate(Rope *rope, size_t at);
+
+/**
+ * The next chunk of text, or NULL once the iterator is past the end.
+ */
+const char *ropeIteratorNext(RopeIterator *iterator, size_t *length);
+
+/*
+ * The editor's edit operations, addressed by line and column, so that the
+ * same edits can be made to a rope as to the rows of a ZipperBuffer.
+ */
+
+Rope *ropeInsertChar(Rope *rope, size_t line, size_t column, int c);
+
+/**
+ * Delete the character before column, or join line onto the previous line
+ * if column is 0.
+ */
+Rope *ropeDeleteChar(Rope *rope, size_t line, size_t column);
+
+Rope *ropeInsertNewline(Rope *rope, size_t line, size_t column);
+
+/**
+ * Screen column of byte at of the line starting at start, with tabs tabSize
+ * wide (as rows render them).
+ */
+int64_t ropeCursorToRender(Rope *rope, size_t start, size_t at, int tabSize);
+
+/**
+ * Render the line starting at start the way a row would be drawn: the part
+ * of it from screen column left, up to width characters, into out. Returns
+ * how many characters it rendered, and sets next to where the next line
+ * starts (the length of the rope if there isn't one). The rope keeps a file's
+ * bytes as they are, so a '\r' of a "\r\n" line ending is drawn as a space
+ * rather than sent to the terminal.
+ */
+int ropeRender(Rope *rope, size_t start, int64_t left, int width, int tabSize,
+               char *out, size_t *next);
+
+#endif
@@ -0,0 +1,882 @@
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lz.h"
+#include "mappedFile.h"
+#include "pool.h"
+#include "rowTree.h"
+#include "util.h"
+
+static Pool nodes = POOL_INIT(RowTree);
+
+/**
+ * Number of times rowTreePack has been called: the time leaves are stamped
+ * with when they're used.
+ */
+static unsigned packClock;
+
+static RowTreeStats stats;
+
+static RowTree *newNode(int height) {
+  RowTree *node = poolAlloc(&nodes);
+  node->references = 1;
+  node->length = 0;
+  node->height = height;
+  node->count = 0;
+  node->source = NULL;
+  node->touched = packClock;
+  node->packed = NULL;
+  return node;
+}
+
+/**
+ * Slots of leaves with a source can hold the index of a line of the source
+ * instead of a row, tagged by setting the lowest bit (rows are aligned, so
+ * it's never set in a pointer to one).
+ */
+static bool isLine(EditorRow *slot) {
+  return (uintptr_t)slot & 1;
+}
+
+static EditorRow *lineSlot(int64_t line) {
+  return (EditorRow *)(((uintptr_t)line << 1) | 1);
+}
+
+static void retainSlot(EditorRow *slot) {
+  if (!isLine(slot)) editorRetainRow(slot);
+}
+
+static void releaseSlot(EditorRow *slot) {
+  if (!isLine(slot)) editorReleaseRow(slot);
+}
+
+/**
+ * Whether node's slots haven't been filled in: it's a range of lines that
+ * hasn't been split up yet, or a packed leaf. A node being filled in on the
+ * editor's thread is only seen to have slots once they're all there.
+ */
+static bool isFolded(RowTree *node) {
+  return __atomic_load_n(&node->count, __ATOMIC_ACQUIRE) == 0;
+}
+
+/**
+ * Most lines a node of this height can hold.
+ */
+static int64_t capacity(int height) {
+  int64_t lines = ROW_TREE_WIDTH;
+  while (height-- > 0) lines *= ROW_TREE_WIDTH;
+  return lines;
+}
+
+/**
+ * A node of this height holding n lines of file, starting from line first,
+ * without any slots.
+ */
+static RowTree *rangeNode(MappedFile *file, int64_t first, int64_t n, int height) {
+  RowTree *node = newNode(height);
+  node->source = mappedFileRetain(file);
+  node->first = first;
+  node->length = n;
+  return node;
+}
+
+/**
+ * Split a range of lines into slots: line numbers for a leaf, or smaller
+ * ranges for a branch, spread evenly. Like making a row for a line, this
+ * changes a node that may be shared, but not the lines it holds.
+ */
+static void splitRange(RowTree *node) {
+  int64_t n = node->length;
+  int count = n;
+  if (node->height == 0) {
+    for (int i = 0; i < count; i++) {
+      node->rows[i] = lineSlot(node->first + i);
+    }
+  } else {
+    int64_t below = capacity(node->height - 1);
+    count = (n + below - 1) / below;
+    for (int i = 0; i < count; i++) {
+      int64_t start = n * i / count;
+      int64_t end = n * (i + 1) / count;
+      node->children[i] = rangeNode(node->source, node->first + start, end - start,
+                                    node->height - 1);
+    }
+  }
+  __atomic_store_n(&node->count, count, __ATOMIC_RELEASE);
+}
+
+/**
+ * The rows of a leaf that hasn't been used for a while, packed into a block
+ * (see rowTreePack). Before they're compressed, the slots are laid out one
+ * after the other, each a PackedSlot followed by numbers (see putNumber):
+ * a row's length and then its characters, a line number, or where a view
+ * of the leaf's source starts and its length.
+ *
+ * tabSize: The rows' tab size.
+ * length: Bytes of slots before they were compressed.
+ * freed: Roughly how much memory the rows took.
+ * size: Bytes of data.
+ */
+struct PackedRows {
+  int tabSize;
+  size_t length;
+  size_t freed;
+  size_t size;
+  char data[];
+};
+
+enum PackedSlot { PackedText, PackedLine, PackedView };
+
+/**
+ * Most bytes a number takes, seven bits at a time.
+ */
+#define NUMBER_SIZE 10
+
+/**
+ * Write n seven bits at a time, lowest first, with the top bit of each
+ * byte set if there are more to come.
+ */
+static unsigned char *putNumber(unsigned char *out, size_t n) {
+  while (n >= 128) {
+    *out++ = (n & 127) | 128;
+    n >>= 7;
+  }
+  *out++ = n;
+  return out;
+}
+
+static const unsigned char *getNumber(const unsigned char *in, size_t *n) {
+  *n = 0;
+  for (int shift = 0;; shift += 7) {
+    *n |= (size_t)(*in & 127) << shift;
+    if (!(*in++ & 128)) return in;
+  }
+}
+
+/**
+ * Room for the slots of a leaf being packed or unpacked. Packing only
+ * happens on the editor's thread, so one will do.
+ */
+static unsigned char *scratch;
+static size_t scratchSize;
+
+static unsigned char *scratchFor(size_t size) {
+  if (size > scratchSize) {
+    scratchSize = size > 2 * scratchSize ? size : 2 * scratchSize;
+    free(scratch);
+    scratch = malloc(scratchSize);
+  }
+  return scratch;
+}
+
+static double secondsSince(struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Whether row is a view of the leaf's source, which can be made again from
+ * where it starts in the mapping.
+ */
+static bool isSourceView(RowTree *leaf, EditorRow *row) {
+  MappedFile *source = leaf->source;
+  return row->view && source != NULL && row->chars >= source->data &&
+    row->chars + row->size <= source->data + source->size;
+}
+
+/**
+ * Pack a leaf's rows into a block, if that frees memory: they have to be
+ * held by this leaf alone (otherwise they'd stay, and unpacking would copy
+ * them), all have the same tab size, and compress to less than half of what
+ * they take.
+ */
+static void pack(RowTree *leaf) {
+  size_t length = 0;
+  size_t freed = 0;
+  int tabSize = -1;
+  for (int i = 0; i < leaf->count; i++) {
+    EditorRow *row = leaf->rows[i];
+    length += 1 + 2 * NUMBER_SIZE;
+    if (isLine(row)) continue;
+    if (row->references > 1 || (tabSize != -1 && row->tabSize != tabSize)) return;
+    tabSize = row->tabSize;
+    length += row->size;
+    freed += sizeof(EditorRow) + (row->view ? 0 : row->size + 1);
+  }
+  if (freed == 0) return;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  unsigned char *slots = scratchFor(length);
+  unsigned char *out = slots;
+  for (int i = 0; i < leaf->count; i++) {
+    EditorRow *row = leaf->rows[i];
+    if (isLine(row)) {
+      *out++ = PackedLine;
+      out = putNumber(out, (uintptr_t)row >> 1);
+    } else if (isSourceView(leaf, row)) {
+      *out++ = PackedView;
+      out = putNumber(out, row->chars - leaf->source->data);
+      out = putNumber(out, row->size);
+    } else {
+      *out++ = PackedText;
+      out = putNumber(out, row->size);
+      memcpy(out, row->chars, row->size);
+      out += row->size;
+    }
+  }
+  length = out - slots;
+  PackedRows *packed = malloc(sizeof(PackedRows) + LZ_BOUND(length));
+  packed->size = lzCompress((char *)slots, length, packed->data);
+  if (sizeof(PackedRows) + packed->size > freed / 2) {
+    free(packed);
+    return;
+  }
+  packed = realloc(packed, sizeof(PackedRows) + packed->size);
+  packed->tabSize = tabSize;
+  packed->length = length;
+  packed->freed = freed;
+  for (int i = 0; i < leaf->count; i++) {
+    releaseSlot(leaf->rows[i]);
+  }
+  leaf->packed = packed;
+  leaf->count = 0;
+  stats.packedLeaves++;
+  stats.packedBytes += sizeof(PackedRows) + packed->size;
+  stats.rowBytes += freed;
+  stats.packs++;
+  stats.packSeconds += secondsSince(&start);
+}
+
+static void dropPacked(RowTree *leaf) {
+  PackedRows *packed = leaf->packed;
+  stats.packedLeaves--;
+  stats.packedBytes -= sizeof(PackedRows) + packed->size;
+  stats.rowBytes -= packed->freed;
+  free(packed);
+  leaf->packed = NULL;
+}
+
+/**
+ * Make a packed leaf's rows again. Like splitting a range, this changes a
+ * node that may be shared, but not the rows it holds.
+ */
+static void unpack(RowTree *leaf) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  PackedRows *packed = leaf->packed;
+  unsigned char *slots = scratchFor(packed->length);
+  lzDecompress(packed->data, packed->size, (char *)slots, packed->length);
+  const unsigned char *in = slots;
+  for (int i = 0; i < leaf->length; i++) {
+    enum PackedSlot type = *in++;
+    size_t n, size;
+    in = getNumber(in, &n);
+    if (type == PackedLine) {
+      leaf->rows[i] = lineSlot(n);
+    } else if (type == PackedView) {
+      in = getNumber(in, &size);
+      leaf->rows[i] = editorRetainRow(newRowView(leaf->source->data + n, size, packed->tabSize));
+    } else {
+      leaf->rows[i] = editorRetainRow(newRowCopy((const char *)in, n, packed->tabSize));
+      in += n;
+    }
+  }
+  dropPacked(leaf);
+  leaf->count = leaf->length;
+  stats.unpacks++;
+  stats.unpackSeconds += secondsSince(&start);
+}
+
+/**
+ * Fill in a folded node's slots (see isFolded).
+ */
+static void unfold(RowTree *node) {
+  if (!isFolded(node)) return;
+  if (node->packed != NULL) {
+    unpack(node);
+  } else {
+    splitRange(node);
+  }
+}
+
+/**
+ * Copy a node, taking a reference to each of its rows or children.
+ */
+static RowTree *copyNode(RowTree *node) {
+  unfold(node);
+  RowTree *copy = poolAlloc(&nodes);
+  *copy = *node;
+  copy->references = 1;
+  mappedFileRetain(copy->source);
+  for (int i = 0; i < copy->count; i++) {
+    if (copy->height == 0) {
+      retainSlot(copy->rows[i]);
+    } else {
+      rowTreeRetain(copy->children[i]);
+    }
+  }
+  return copy;
+}
+
+RowTree *rowTreeRetain(RowTree *tree) {
+  if (tree != NULL) tree->references++;
+  return tree;
+}
+
+void rowTreeRelease(RowTree *tree) {
+  if (tree == NULL || --tree->references > 0) return;
+  for (int i = 0; i < tree->count; i++) {
+    if (tree->height == 0) {
+      releaseSlot(tree->rows[i]);
+    } else {
+      rowTreeRelease(tree->children[i]);
+    }
+  }
+  if (tree->packed != NULL) dropPacked(tree);
+  mappedFileRelease(tree->source);
+  poolFree(&nodes, tree);
+}
+
+static void updateLength(RowTree *node) {
+  if (node->height == 0) {
+    node->length = node->count;
+    return;
+  }
+  int64_t length = 0;
+  for (int i = 0; i < node->count; i++) {
+    length += node->children[i]->length;
+  }
+  node->length = length;
+}
+
+/**
+ * The slot of the child holding index. On return, index is relative to that
+ * child.
+ */
+static int childFor(RowTree *node, int64_t *index) {
+  int slot = 0;
+  while (slot < node->count - 1 && *index >= node->children[slot]->length) {
+    *index -= node->children[slot]->length;
+    slot++;
+  }
+  return slot;
+}
+
+static void insertSlot(RowTree *node, int slot, EditorRow *row, RowTree *child) {
+  if (node->height == 0) {
+    memmove(node->rows + slot + 1, node->rows + slot,
+            (node->count - slot) * sizeof(EditorRow *));
+    node->rows[slot] = editorRetainRow(row);
+  } else {
+    memmove(node->children + slot + 1, node->children + slot,
+            (node->count - slot) * sizeof(RowTree *));
+    node->children[slot] = child;
+  }
+  node->count++;
+}
+
+/**
+ * Remove a slot, giving up the node's reference to what was in it.
+ */
+static void removeSlot(RowTree *node, int slot) {
+  if (node->height == 0) {
+    releaseSlot(node->rows[slot]);
+    memmove(node->rows + slot, node->rows + slot + 1,
+            (node->count - slot - 1) * sizeof(EditorRow *));
+  } else {
+    rowTreeRelease(node->children[slot]);
+    memmove(node->children + slot, node->children + slot + 1,
+            (node->count - slot - 1) * sizeof(RowTree *));
+  }
+  node->count--;
+}
+
+/**
+ * Move n slots starting at start in from to position at in to. Both nodes must
+ * be unshared copies of the same height.
+ */
+static void moveSlots(RowTree *from, int start, int n, RowTree *to, int at) {
+  if (to->source == NULL) {
+    to->source = mappedFileRetain(from->source);
+  }
+  if (from->height == 0) {
+    memmove(to->rows + at + n, to->rows + at, (to->count - at) * sizeof(EditorRow *));
+    memcpy(to->rows + at, from->rows + start, n * sizeof(EditorRow *));
+    memmove(from->rows + start, from->rows + start + n,
+            (from->count - start - n) * sizeof(EditorRow *));
+  } else {
+    memmove(to->children + at + n, to->children + at,
+            (to->count - at) * sizeof(RowTree *));
+    memcpy(to->children + at, from->children + start, n * sizeof(RowTree *));
+    memmove(from->children + start, from->children + start + n,
+            (from->count - start - n) * sizeof(RowTree *));
+  }
+  to->count += n;
+  from->count -= n;
+  updateLength(to);
+  updateLength(from);
+}
+
+/**
+ * Move the upper half of node's slots into a new sibling, and return it.
+ */
+static RowTree *splitNode(RowTree *node) {
+  RowTree *right = newNode(node->height);
+  int keep = node->count / 2;
+  moveSlots(node, keep, node->count - keep, right, 0);
+  return right;
+}
+
+int64_t rowTreeLength(RowTree *tree) {
+  return tree == NULL ? 0 : tree->length;
+}
+
+EditorRow *rowTreeGet(RowTree *tree, int64_t index) {
+  int64_t start;
+  RowTree *leaf = rowTreeLeaf(tree, index, &start);
+  return leaf == NULL ? NULL : rowTreeLeafRow(leaf, index - start);
+}
+
+EditorRow *rowTreeLeafRow(RowTree *leaf, int slot) {
+  leaf->touched = packClock;
+  stats.reads++;
+  EditorRow *row = leaf->rows[slot];
+  if (isLine(row)) {
+    row = editorRetainRow(mappedFileRow(leaf->source, (uintptr_t)row >> 1));
+    // released so that a background save reading the slot (see
+    // rowIteratorNextText) sees the whole row
+    __atomic_store_n(&leaf->rows[slot], row, __ATOMIC_RELEASE);
+  }
+  return row;
+}
+
+RowTree *rowTreeLeaf(RowTree *tree, int64_t index, int64_t *start) {
+  if (tree == NULL || index < 0 || index >= tree->length) return NULL;
+  *start = index;
+  unfold(tree);
+  while (tree->height > 0) {
+    tree = tree->children[childFor(tree, &index)];
+    unfold(tree);
+  }
+  *start -= index;
+  return tree;
+}
+
+static RowTree *setIn(RowTree *node, int64_t index, EditorRow *row) {
+  RowTree *copy = copyNode(node);
+  if (node->height == 0) {
+    editorRetainRow(row);
+    releaseSlot(copy->rows[index]);
+    copy->rows[index] = row;
+  } else {
+    int slot = childFor(node, &index);
+    RowTree *child = setIn(node->children[slot], index, row);
+    rowTreeRelease(copy->children[slot]);
+    copy->children[slot] = child;
+  }
+  return copy;
+}
+
+RowTree *rowTreeSet(RowTree *tree, int64_t index, EditorRow *row) {
+  if (tree == NULL || index < 0 || index >= tree->length) return rowTreeRetain(tree);
+  return setIn(tree, index, row);
+}
+
+/**
+ * Insert into a copy of node. If the copy overflows it's split, and the new
+ * right half is returned through sibling.
+ */
+static RowTree *insertInto(RowTree *node, int64_t index, EditorRow *row, RowTree **sibling) {
+  RowTree *copy = copyNode(node);
+  RowTree *child = NULL;
+  int slot = index;
+  *sibling = NULL;
+  if (node->height > 0) {
+    slot = childFor(node, &index);
+    RowTree *changed = insertInto(node->children[slot], index, row, &child);
+    rowTreeRelease(copy->children[slot]);
+    copy->children[slot] = changed;
+    if (child == NULL) {
+      copy->length++;
+      return copy;
+    }
+    slot++;
+  }
+  RowTree *target = copy;
+  if (copy->count == ROW_TREE_WIDTH) {
+    *sibling = splitNode(copy);
+    if (slot > copy->count) {
+      slot -= copy->count;
+      target = *sibling;
+    }
+  }
+  insertSlot(target, slot, row, child);
+  updateLength(target);
+  return copy;
+}
+
+RowTree *rowTreeInsert(RowTree *tree, int64_t index, EditorRow *row) {
+  if (tree == NULL) {
+    RowTree *leaf = newNode(0);
+    insertSlot(leaf, 0, row, NULL);
+    updateLength(leaf);
+    return leaf;
+  }
+  RowTree *sibling;
+  RowTree *root = insertInto(tree, clip(index, 0, tree->length), row, &sibling);
+  if (sibling == NULL) return root;
+  RowTree *parent = newNode(root->height + 1);
+  insertSlot(parent, 0, NULL, root);
+  insertSlot(parent, 1, NULL, sibling);
+  updateLength(parent);
+  return parent;
+}
+
+/**
+ * Bring the child at slot (already an unshared copy) back up to the minimum
+ * fill, by merging it with a sibling or sharing the sibling's slots out.
+ */
+static void rebalance(RowTree *parent, int slot) {
+  int left = slot > 0 ? slot - 1 : slot;
+  int sibling = slot > 0 ? slot - 1 : slot + 1;
+  RowTree *shared = parent->children[sibling];
+  parent->children[sibling] = copyNode(shared);
+  rowTreeRelease(shared);
+  RowTree *l = parent->children[left];
+  RowTree *r = parent->children[left + 1];
+  int total = l->count + r->count;
+  if (total <= ROW_TREE_WIDTH) {
+    moveSlots(r, 0, r->count, l, l->count);
+    removeSlot(parent, left + 1);
+  } else if (l->count < total / 2) {
+    moveSlots(r, 0, total / 2 - l->count, l, l->count);
+  } else {
+    moveSlots(l, total / 2, l->count - total / 2, r, 0);
+  }
+}
+
+/**
+ * Delete from a copy of node, returning NULL if nothing is left. The copy may
+ * end up below the minimum fill; the parent fixes that up.
+ */
+static RowTree *deleteFrom(RowTree *node, int64_t index) {
+  if (node->length == 1) return NULL;
+  RowTree *copy = copyNode(node);
+  if (node->height == 0) {
+    removeSlot(copy, index);
+  } else {
+    int slot = childFor(node, &index);
+    RowTree *child = deleteFrom(node->children[slot], index);
+    if (child == NULL) {
+      removeSlot(copy, slot);
+    } else {
+      rowTreeRelease(copy->children[slot]);
+      copy->children[slot] = child;
+      if (child->count < ROW_TREE_MIN && copy->count > 1) {
+        rebalance(copy, slot);
+      }
+    }
+  }
+  updateLength(copy);
+  return copy;
+}
+
+RowTree *rowTreeDelete(RowTree *tree, int64_t index) {
+  if (tree == NULL || index < 0 || index >= tree->length) return rowTreeRetain(tree);
+  RowTree *root = deleteFrom(tree, index);
+  while (root != NULL && root->height > 0 && root->count == 1) {
+    RowTree *child = rowTreeRetain(root->children[0]);
+    rowTreeRelease(root);
+    root = child;
+  }
+  return root;
+}
+
+/**
+ * Build the upper levels of a tree over count leaves, in order. Frees level.
+ */
+static RowTree *fromLeaves(RowTree **level, int count) {
+  while (count > 1) {
+    int parents = (count + ROW_TREE_WIDTH - 1) / ROW_TREE_WIDTH;
+    for (int i = 0; i < parents; i++) {
+      int start = (int64_t)count * i / parents;
+      int end = (int64_t)count * (i + 1) / parents;
+      RowTree *parent = newNode(level[start]->height + 1);
+      memcpy(parent->children, level + start, (end - start) * sizeof(RowTree *));
+      parent->count = end - start;
+      updateLength(parent);
+      level[i] = parent;
+    }
+    count = parents;
+  }
+  RowTree *root = level[0];
+  free(level);
+  return root;
+}
+
+/**
+ * Leaves for n rows, spread evenly.
+ */
+static RowTree **leaves(EditorRow **rows, int64_t n, int *count) {
+  *count = (n + ROW_TREE_WIDTH - 1) / ROW_TREE_WIDTH;
+  RowTree **level = malloc(*count * sizeof(RowTree *));
+  for (int i = 0; i < *count; i++) {
+    int64_t start = n * i / *count;
+    int64_t end = n * (i + 1) / *count;
+    RowTree *leaf = newNode(0);
+    for (int64_t j = start; j < end; j++) {
+      insertSlot(leaf, j - start, rows[j], NULL);
+    }
+    updateLength(leaf);
+    level[i] = leaf;
+  }
+  return level;
+}
+
+RowTree *rowTreeFromArray(EditorRow **rows, int64_t n) {
+  if (n <= 0) return NULL;
+  int count;
+  RowTree **level = leaves(rows, n, &count);
+  return fromLeaves(level, count);
+}
+
+RowTree *rowTreeFromMappedFile(MappedFile *file) {
+  return rowTreeAppendLines(NULL, file, 0, file->count);
+}
+
+/**
+ * A copy of node with tree added as its last child, or as the last child of
+ * the last child and so on down to the level above tree's height. If the
+ * copy overflows it's split, and the new right half is returned through
+ * sibling.
+ */
+static RowTree *joinRight(RowTree *node, RowTree *tree, RowTree **sibling) {
+  RowTree *copy = copyNode(node);
+  RowTree *child;
+  *sibling = NULL;
+  if (node->height > tree->height + 1) {
+    int last = node->count - 1;
+    RowTree *changed = joinRight(node->children[last], tree, &child);
+    rowTreeRelease(copy->children[last]);
+    copy->children[last] = changed;
+    updateLength(copy);
+    if (child == NULL) return copy;
+  } else {
+    child = rowTreeRetain(tree);
+  }
+  RowTree *target = copy;
+  if (copy->count == ROW_TREE_WIDTH) {
+    *sibling = splitNode(copy);
+    target = *sibling;
+  }
+  insertSlot(target, target->count, NULL, child);
+  updateLength(target);
+  return copy;
+}
+
+/**
+ * As joinRight, but adding tree before node's rows rather than after them.
+ */
+static RowTree *joinLeft(RowTree *tree, RowTree *node, RowTree **sibling) {
+  RowTree *copy = copyNode(node);
+  RowTree *child;
+  int slot = 0;
+  *sibling = NULL;
+  if (node->height > tree->height + 1) {
+    RowTree *changed = joinLeft(tree, node->children[0], &child);
+    rowTreeRelease(copy->children[0]);
+    copy->children[0] = changed;
+    updateLength(copy);
+    if (child == NULL) return copy;
+    // the changed child's split off right half goes after it
+    slot = 1;
+  } else {
+    child = rowTreeRetain(tree);
+  }
+  if (copy->count == ROW_TREE_WIDTH) {
+    *sibling = splitNode(copy);
+  }
+  insertSlot(copy, slot, NULL, child);
+  updateLength(copy);
+  return copy;
+}
+
+/**
+ * A tree holding left's rows followed by right's.
+ */
+static RowTree *join(RowTree *left, RowTree *right) {
+  if (left == NULL) return rowTreeRetain(right);
+  if (right == NULL) return rowTreeRetain(left);
+  if (left->height == right->height) {
+    unfold(left);
+    unfold(right);
+  }
+  RowTree *root;
+  RowTree *sibling;
+  if (left->height > right->height) {
+    root = joinRight(left, right, &sibling);
+  } else if (left->height < right->height) {
+    root = joinLeft(left, right, &sibling);
+  } else if (left->count + right->count <= ROW_TREE_WIDTH) {
+    root = copyNode(left);
+    if (root->source == NULL) root->source = mappedFileRetain(right->source);
+    for (int i = 0; i < right->count; i++) {
+      if (root->height == 0) {
+        retainSlot(right->rows[i]);
+        root->rows[root->count++] = right->rows[i];
+      } else {
+        root->children[root->count++] = rowTreeRetain(right->children[i]);
+      }
+    }
+    updateLength(root);
+    return root;
+  } else {
+    root = rowTreeRetain(left);
+    sibling = rowTreeRetain(right);
+  }
+  if (sibling == NULL) return root;
+  RowTree *parent = newNode(root->height + 1);
+  insertSlot(parent, 0, NULL, root);
+  insertSlot(parent, 1, NULL, sibling);
+  updateLength(parent);
+  return parent;
+}
+
+RowTree *rowTreeAppendLines(RowTree *tree, MappedFile *file, int64_t from, int64_t to) {
+  if (to <= from) return rowTreeRetain(tree);
+  int height = 0;
+  while (capacity(height) < to - from) height++;
+  RowTree *lines = rangeNode(file, from, to - from, height);
+  RowTree *joined = join(tree, lines);
+  rowTreeRelease(lines);
+  return joined;
+}
+
+/**
+ * Pack the leaves under node that haven't been used in the last age passes.
+ */
+static void packOlder(RowTree *node, unsigned age) {
+  if (isFolded(node)) return;
+  if (node->height > 0) {
+    for (int i = 0; i < node->count; i++) {
+      packOlder(node->children[i], age);
+    }
+  } else if (packClock - node->touched >= age) {
+    pack(node);
+  }
+}
+
+void rowTreePack(RowTree *tree, unsigned age) {
+  if (tree != NULL) packOlder(tree, age);
+  packClock++;
+}
+
+void rowTreeUnpack(RowTree *tree) {
+  if (tree == NULL) return;
+  if (tree->packed != NULL) {
+    unpack(tree);
+  } else if (tree->height > 0 && !isFolded(tree)) {
+    for (int i = 0; i < tree->count; i++) {
+      rowTreeUnpack(tree->children[i]);
+    }
+  }
+}
+
+RowTreeStats rowTreeStats(void) {
+  return stats;
+}
+
+/**
+ * Go down from the node at level h of the iterator to the leaf (or range of
+ * lines) holding the row at index within it.
+ */
+static void descend(RowIterator *iterator, int h, int64_t index) {
+  RowTree *node = iterator->nodes[h];
+  bool folded;
+  while (!(folded = isFolded(node)) && h > 0) {
+    iterator->slots[h] = childFor(node, &index);
+    node = node->children[iterator->slots[h]];
+    iterator->nodes[--h] = node;
+  }
+  iterator->bottom = h;
+  iterator->folded = folded;
+  iterator->end = folded ? node->length : node->count;
+  iterator->slots[h] = index;
+}
+
+RowIterator rowTreeIterate(RowTree *tree, int64_t index) {
+  RowIterator iterator;
+  iterator.nodes[0] = NULL;
+  iterator.height = 0;
+  iterator.bottom = 0;
+  iterator.folded = false;
+  iterator.file = NULL;
+  if (tree == NULL || index >= tree->length) return iterator;
+  if (index < 0) index = 0;
+  iterator.height = tree->height;
+  iterator.nodes[tree->height] = tree;
+  descend(&iterator, tree->height, index);
+  return iterator;
+}
+
+/**
+ * The slot the iterator is on, and its leaf (or folded node, setting folded),
+ * moving the iterator on to the next slot. Returns NULL at the end.
+ */
+static RowTree *iteratorAdvance(RowIterator *iterator, int64_t *slot, bool *folded) {
+  int h = iterator->bottom;
+  RowTree *node = iterator->nodes[h];
+  if (node == NULL) return NULL;
+  *slot = iterator->slots[h]++;
+  *folded = iterator->folded;
+  if (iterator->slots[h] < iterator->end) return node;
+  h++;
+  while (h <= iterator->height && ++iterator->slots[h] >= iterator->nodes[h]->count) {
+    h++;
+  }
+  if (h > iterator->height) {
+    iterator->nodes[iterator->bottom] = NULL;
+    return node;
+  }
+  iterator->nodes[h - 1] = iterator->nodes[h]->children[iterator->slots[h]];
+  descend(iterator, h - 1, 0);
+  return node;
+}
+
+EditorRow *rowIteratorNext(RowIterator *iterator) {
+  // fill in the folded node the iterator is in down to the leaf it's on
+  while (iterator->folded && iterator->nodes[iterator->bottom] != NULL) {
+    unfold(iterator->nodes[iterator->bottom]);
+    descend(iterator, iterator->bottom, iterator->slots[iterator->bottom]);
+  }
+  int64_t slot;
+  bool folded;
+  RowTree *leaf = iteratorAdvance(iterator, &slot, &folded);
+  return leaf == NULL ? NULL : rowTreeLeafRow(leaf, slot);
+}
+
+const char *rowIteratorNextText(RowIterator *iterator, size_t *length) {
+  int64_t slot;
+  bool folded;
+  RowTree *leaf = iteratorAdvance(iterator, &slot, &folded);
+  if (leaf == NULL) return NULL;
+  // with no packed leaves, a folded node is a range of lines
+  EditorRow *row = folded ? lineSlot(leaf->first + slot)
+                         : __atomic_load_n(&leaf->rows[slot], __ATOMIC_ACQUIRE);
+  if (isLine(row)) {
+    int64_t line = (uintptr_t)row >> 1;
+    if (iterator->file != leaf->source || iterator->line != line) {
+      iterator->file = leaf->source;
+      iterator->start = mappedFileLineStart(leaf->source, line);
+    }
+    iterator->line = line + 1;
+    return mappedFileLineAt(leaf->source, iterator->start, length, &iterator->start);
+  }
+  *length = row->size;
+  return row->chars;
+}
@@ -0,0 +1,225 @@
+#ifndef ROW_TREE
+#define ROW_TREE
+
+#include "editorRow.h"
+#include "mappedFile.h"
+
+/**
+ * Number of slots in each node: rows in a leaf, children in a branch.
+ */
+#define ROW_TREE_WIDTH 32
+
+/**
+ * Nodes (other than the root) with fewer slots than this in use are merged
+ * with or topped up from a sibling after a delete.
+ */
+#define ROW_TREE_MIN (ROW_TREE_WIDTH / 4)
+
+/**
+ * Enough levels for more than 2^31 rows, even with every node at the minimum
+ * fill.
+ */
+#define ROW_TREE_MAX_HEIGHT 16
+
+typedef struct RowTree RowTree;
+
+typedef struct PackedRows PackedRows;
+
+/**
+ * A persistent, balanced tree of rows (a B+ tree whose leaves are chunks of
+ * up to ROW_TREE_WIDTH rows). Nodes are never modified once they're reachable
+ * from a tree: every operation copies the path from the root to the node it
+ * changes and returns the new root, so old roots (e.g. in the undo history)
+ * still see the old rows. The empty tree is NULL.
+ *
+ * Nodes and rows are reference counted, and freed once nothing holds them.
+ * Every operation that returns a tree returns a new reference, which the
+ * caller gives up with rowTreeRelease; the tree passed in is left as it was.
+ *
+ * references: Number of parents and other holders (buffers, undo entries)
+ *   pointing at this node.
+ * length: Number of rows in this node and all of its descendants.
+ * height: 0 for a leaf (whose slots hold rows), otherwise one more than the
+ *   height of the children.
+ * count: Number of slots in use.
+ * source: For leaves of trees made from a mapped file, the file. Until
+ *   they're first looked at, the leaf's rows are just line numbers in it, so
+ *   that opening a file doesn't make a row for every line. NULL otherwise.
+ * first: For a node with no slots (a count of 0), which holds length lines
+ *   of source starting from this one. The lines of a mapped file start out
+ *   as one such range, which is only split into slots (smaller ranges, and
+ *   then line numbers) as the rows in it are looked at, so that the tree for
+ *   a file with hundreds of millions of lines starts out as a single node.
+ * touched: When the leaf's rows were last used (see rowTreePack).
+ * packed: For a leaf whose rows haven't been used for a while, and have been
+ *   packed into a compressed block to save memory (with a count of 0, like a
+ *   range of lines). It's unpacked the next time its rows are needed.
+ */
+struct RowTree {
+  int references;
+  int64_t length;
+  int height;
+  int count;
+  MappedFile *source;
+  int64_t first;
+  unsigned touched;
+  PackedRows *packed;
+  union {
+    EditorRow *rows[ROW_TREE_WIDTH];
+    RowTree *children[ROW_TREE_WIDTH];
+  };
+};
+
+/**
+ * Take another reference to tree, and return it.
+ */
+RowTree *rowTreeRetain(RowTree *tree);
+
+/**
+ * Give up a reference to tree, freeing the nodes and rows only it held.
+ */
+void rowTreeRelease(RowTree *tree);
+
+int64_t rowTreeLength(RowTree *tree);
+
+/**
+ * The row at index, or NULL if index is out of range.
+ */
+EditorRow *rowTreeGet(RowTree *tree, int64_t index);
+
+/**
+ * The leaf holding the row at index, or NULL if index is out of range. start
+ * is set to the index of the leaf's first row.
+ */
+RowTree *rowTreeLeaf(RowTree *tree, int64_t index, int64_t *start);
+
+/**
+ * The row in slot of leaf, making it from the leaf's source file if needed.
+ */
+EditorRow *rowTreeLeafRow(RowTree *leaf, int slot);
+
+/**
+ * A new tree with the row at index replaced by row.
+ */
+RowTree *rowTreeSet(RowTree *tree, int64_t index, EditorRow *row);
+
+/**
+ * A new tree with row inserted before the row at index. An index equal to the
+ * length of the tree appends.
+ */
+RowTree *rowTreeInsert(RowTree *tree, int64_t index, EditorRow *row);
+
+/**
+ * A new tree without the row at index.
+ */
+RowTree *rowTreeDelete(RowTree *tree, int64_t index);
+
+/**
+ * Build a tree holding the n rows in order, in O(n).
+ */
+RowTree *rowTreeFromArray(EditorRow **rows, int64_t n);
+
+/**
+ * Build a tree holding the lines of file indexed so far, without making rows
+ * (or leaves) for them yet.
+ */
+RowTree *rowTreeFromMappedFile(MappedFile *file);
+
+/**
+ * A tree holding tree's rows followed by lines from to to of file (as they
+ * get indexed), without making rows or leaves for them. Takes O(log n).
+ */
+RowTree *rowTreeAppendLines(RowTree *tree, MappedFile *file, int64_t from,
+                            int64_t to);
+
+/**
+ * What packing rows has done so far, across all trees.
+ *
+ * packedLeaves, packedBytes, rowBytes: Leaves packed now, the memory their
+ *   blocks take, and roughly how much their rows took before.
+ * packs, unpacks: Leaves packed, and unpacked again because their rows were
+ *   needed: the misses.
+ * reads: Rows read from leaves (see rowTreeLeafRow), which don't need a leaf
+ *   unpacked unless they're a miss.
+ * packSeconds, unpackSeconds: Time spent packing and unpacking.
+ */
+typedef struct RowTreeStats {
+  int packedLeaves;
+  size_t packedBytes;
+  size_t rowBytes;
+  long packs;
+  long unpacks;
+  long reads;
+  double packSeconds;
+  double unpackSeconds;
+} RowTreeStats;
+
+/**
+ * Pack the rows of each of tree's leaves that haven't been used since the
+ * last age calls (so all of them for an age of 0) into a compressed block
+ * (see lz.h), so that rows far from the cursor, which are most of a big
+ * buffer's, take a fraction of the memory.
+ * A leaf is only packed if that frees its rows: if they're shared with
+ * other versions of the tree (whose leaves are different), they're kept.
+ *
+ * Packing changes nodes that other threads might be reading, so it mustn't
+ * be done to a tree while one is (e.g. while it's being saved).
+ */
+void rowTreePack(RowTree *tree, unsigned age);
+
+/**
+ * Unpack every packed leaf of tree, e.g. before another thread reads it.
+ */
+void rowTreeUnpack(RowTree *tree);
+
+RowTreeStats rowTreeStats(void);
+
+/**
+ * Position in a tree, as the slot taken at each level on the way down from the
+ * root. Lives on the stack, so walking rows doesn't allocate.
+ *
+ * bottom: The level of the node the iterator is in: 0 for a leaf, or the
+ *   height of a node whose slots haven't been filled in (a range of lines
+ *   that hasn't been split up yet, or a packed leaf: see RowTree), for which
+ *   folded is set and the slot is the row within the node.
+ * end: Number of slots (or lines) in the node at the bottom.
+ * file, line, start: Where the line after the last one rowIteratorNextText
+ *   read from a mapped file starts, so that reading lines in order doesn't
+ *   go through the file's index for each one.
+ */
+typedef struct RowIterator {
+  int height;
+  int bottom;
+  bool folded;
+  int64_t end;
+  RowTree *nodes[ROW_TREE_MAX_HEIGHT];
+  int64_t slots[ROW_TREE_MAX_HEIGHT];
+  MappedFile *file;
+  int64_t line;
+  size_t start;
+} RowIterator;
+
+/**
+ * An iterator whose first row is the one at index.
+ */
+RowIterator rowTreeIterate(RowTree *tree, int64_t index);
+
+/**
+ * The next row, or NULL once the iterator has gone past the last row.
+ */
+EditorRow *rowIteratorNext(RowIterator *iterator);
+
+/**
+ * Like rowIteratorNext, but gives the characters of the next row (setting
+ * length to how many there are) rather than the row. Lines of a mapped file
+ * that haven't been made into rows yet are read straight from the mapping,
+ * without making them into rows (or splitting up ranges of them), so this
+ * doesn't change the tree. It can run on another thread while the tree is
+ * used (and edited, which makes new trees) on the editor's thread, as long as
+ * that thread keeps a reference to it, the file's index isn't added to
+ * meanwhile (see MappedFile's saving), and the tree has no packed leaves (see
+ * rowTreeUnpack).
+ */
+const char *rowIteratorNextText(RowIterator *iterator, size_t *length);
+
+#endif
@@ -0,0 +1,275 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "mappedFile.h"
+#include "rope.h"
+#include "rowTree.h"
+#include "save.h"
+
+static char newline[] = "\n";
+
+/**
+ * Write all of n slices, however many writev calls it takes. Changes the
+ * slices.
+ */
+static bool writeSlices(int fileDescriptor, struct iovec *slices, int n) {
+  while (n > 0) {
+    ssize_t got = writev(fileDescriptor, slices, n);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    while (n > 0 && (size_t)got >= slices->iov_len) {
+      got -= slices->iov_len;
+      slices++;
+      n--;
+    }
+    if (n > 0) {
+      slices->iov_base = (char *)slices->iov_base + got;
+      slices->iov_len -= got;
+    }
+  }
+  return true;
+}
+
+/**
+ * Lines being gathered into slices for writev. The last line (or run of
+ * lines) isn't added to the slices until the next one comes, in case that
+ * follows on from it in memory.
+ */
+typedef struct Batch {
+  struct iovec slices[SAVE_BATCH];
+  int n;
+  const char *pending;
+  size_t pendingLength;
+} Batch;
+
+/**
+ * Add a line and its newline to the batch, writing the batch out first if
+ * it's full.
+ */
+static bool addLine(int fileDescriptor, Batch *batch, const char *chars,
+                    size_t length) {
+  if (batch->n + 2 > SAVE_BATCH) {
+    if (!writeSlices(fileDescriptor, batch->slices, batch->n)) return false;
+    batch->n = 0;
+  }
+  batch->slices[batch->n++] = (struct iovec){(char *)chars, length};
+  batch->slices[batch->n++] = (struct iovec){newline, 1};
+  return true;
+}
+
+/**
+ * Add a line to the batch, joining it onto the pending lines if it comes
+ * straight after them.
+ */
+static bool batchLine(int fileDescriptor, Batch *batch, const char *chars,
+                      size_t length) {
+  const char *pending = batch->pending;
+  if (pending != NULL && chars == pending + batch->pendingLength + 1 &&
+      pending[batch->pendingLength] == '\n') {
+    batch->pendingLength += 1 + length;
+    return true;
+  }
+  if (pending != NULL &&
+      !addLine(fileDescriptor, batch, pending, batch->pendingLength)) {
+    return false;
+  }
+  batch->pending = chars;
+  batch->pendingLength = length;
+  return true;
+}
+
+bool writeRows(int fileDescriptor, RowTree *rows, MappedFile *rest,
+               size_t from, size_t *written) {
+  Batch batch;
+  batch.n = 0;
+  batch.pending = NULL;
+  batch.pendingLength = 0;
+  *written = 0;
+  RowIterator iterator = rowTreeIterate(rows, 0);
+  const char *chars;
+  size_t length;
+  while ((chars = rowIteratorNextText(&iterator, &length)) != NULL) {
+    *written += length + 1;
+    if (!batchLine(fileDescriptor, &batch, chars, length)) return false;
+  }
+  // the lines that haven't been indexed, found the way indexing finds them
+  while (rest != NULL && from < rest->size) {
+    chars = mappedFileLineAt(rest, from, &length, &from);
+    *written += length + 1;
+    if (!batchLine(fileDescriptor, &batch, chars, length)) return false;
+  }
+  if (batch.pending != NULL &&
+      !addLine(fileDescriptor, &batch, batch.pending, batch.pendingLength)) {
+    return false;
+  }
+  return writeSlices(fileDescriptor, batch.slices, batch.n);
+}
+
+bool writeRope(int fileDescriptor, Rope *rope, size_t *written) {
+  struct iovec slices[SAVE_BATCH];
+  int n = 0;
+  *written = 0;
+  RopeIterator iterator = ropeIterate(rope, 0);
+  const char *chunk;
+  size_t length;
+  while ((chunk = ropeIteratorNext(&iterator, &length)) != NULL) {
+    *written += length;
+    if (n > 0 && chunk == (char *)slices[n - 1].iov_base + slices[n - 1].iov_len) {
+      slices[n - 1].iov_len += length;
+      continue;
+    }
+    if (n == SAVE_BATCH) {
+      if (!writeSlices(fileDescriptor, slices, n)) return false;
+      n = 0;
+    }
+    slices[n++] = (struct iovec){(char *)chunk, length};
+  }
+  return writeSlices(fileDescriptor, slices, n);
+}
+
+/**
+ * Flush the directory holding filename, so that a rename in it is on disk.
+ */
+static void syncDirectory(const char *filename) {
+  const char *slash = strrchr(filename, '/');
+  char *directory = slash == NULL ? strdup(".")
+                    : strndup(filename, slash == filename ? 1 : slash - filename);
+  int fileDescriptor = open(directory, O_RDONLY);
+  if (fileDescriptor != -1) {
+    fsync(fileDescriptor);
+    close(fileDescriptor);
+  }
+  free(directory);
+}
+
+/**
+ * Give the file open on fileDescriptor the owner and group in status if we're
+ * allowed to (only root can give a file away), or else just the group.
+ * Returns whether it has status's owner; if not, it's left ours.
+ */
+static bool keepOwner(int fileDescriptor, const struct stat *status) {
+  if (fchown(fileDescriptor, status->st_uid, status->st_gid) == 0) return true;
+  return fchown(fileDescriptor, -1, status->st_gid) == 0 &&
+         status->st_uid == geteuid();
+}
+
+/**
+ * Save to filename as saveRows does, writing rope if it isn't NULL and
+ * otherwise rows and rest.
+ */
+static bool replaceFile(const char *filename, RowTree *rows, MappedFile *rest,
+                        size_t from, Rope *rope, size_t *written) {
+  // save over the file a symbolic link points to, rather than the link
+  char *target = realpath(filename, NULL);
+  if (target == NULL) target = strdup(filename);
+  struct stat status;
+  bool exists = stat(target, &status) == 0;
+  mode_t mode = exists ? status.st_mode & 07777 : 0644;
+  char *temporary = malloc(strlen(target) + 8);
+  sprintf(temporary, "%s.XXXXXX", target);
+  int fileDescriptor = mkstemp(temporary);
+  if (fileDescriptor == -1) {
+    free(temporary);
+    free(target);
+    return false;
+  }
+  if (exists) keepOwner(fileDescriptor, &status);
+  bool saved = fchmod(fileDescriptor, mode) != -1 &&
+               (rope != NULL ? writeRope(fileDescriptor, rope, written)
+                : writeRows(fileDescriptor, rows, rest, from, written)) &&
+               fsync(fileDescriptor) != -1;
+  saved = close(fileDescriptor) == 0 && saved;
+  saved = saved && rename(temporary, target) == 0;
+  if (saved) {
+    syncDirectory(target);
+  } else {
+    int error = errno;
+    unlink(temporary);
+    errno = error;
+  }
+  free(temporary);
+  free(target);
+  return saved;
+}
+
+bool saveRows(const char *filename, RowTree *rows, MappedFile *rest,
+              size_t from, size_t *written) {
+  return replaceFile(filename, rows, rest, from, NULL, written);
+}
+
+bool saveRope(const char *filename, Rope *rope, size_t *written) {
+  return replaceFile(filename, NULL, NULL, 0, rope, written);
+}
+
+static void *saveThread(void *argument) {
+  Save *save = argument;
+  save->saved = replaceFile(save->filename, save->rows, save->rest, save->from,
+                            save->rope, &save->written);
+  save->error = errno;
+  atomic_store(&save->finished, true);
+  return NULL;
+}
+
+/**
+ * Start save's thread, or do the save here if a thread can't be made.
+ */
+static Save *startSave(Save *save) {
+  save->saved = false;
+  save->written = 0;
+  save->error = 0;
+  atomic_init(&save->finished, false);
+  save->threaded = pthread_create(&save->thread, NULL, saveThread, save) == 0;
+  if (!save->threaded) saveThread(save);
+  return save;
+}
+
+Save *saveInBackground(const char *filename, RowTree *rows, MappedFile *rest,
+                       size_t from) {
+  Save *save = malloc(sizeof(*save));
+  save->filename = strdup(filename);
+  save->rows = rowTreeRetain(rows);
+  save->rest = mappedFileRetain(rest);
+  save->from = from;
+  save->rope = NULL;
+  if (rest != NULL) rest->saving++;
+  rowTreeUnpack(rows);
+  return startSave(save);
+}
+
+Save *saveRopeInBackground(const char *filename, Rope *rope) {
+  Save *save = malloc(sizeof(*save));
+  save->filename = strdup(filename);
+  save->rows = NULL;
+  save->rest = NULL;
+  save->from = 0;
+  save->rope = ropeRetain(rope);
+  return startSave(save);
+}
+
+bool saveFinished(Save *save) {
+  return atomic_load(&save->finished);
+}
+
+bool saveWait(Save *save, size_t *written) {
+  if (save->threaded) pthread_join(save->thread, NULL);
+  bool saved = save->saved;
+  *written = save->written;
+  rowTreeRelease(save->rows);
+  ropeRelease(save->rope);
+  if (save->rest != NULL) save->rest->saving--;
+  mappedFileRelease(save->rest);
+  free(save->filename);
+  int error = save->error;
+  free(save);
+  errno = error;
+  return saved;
+}
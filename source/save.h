@@ -0,0 +1,124 @@
+#ifndef SAVE
+#define SAVE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "mappedFile.h"
+#include "rope.h"
+#include "rowTree.h"
+
+/**
+ * Number of slices gathered for each writev (IOV_MAX on Linux).
+ */
+#define SAVE_BATCH 1024
+
+/**
+ * Write each of rows followed by a newline to fileDescriptor, gathering
+ * slices of the rows into batches for writev rather than copying them. Lines
+ * of a mapped file that are still next to each other in the mapping go out as
+ * a single slice. rows mustn't have packed leaves (see rowTreeUnpack).
+ *
+ * If rest isn't NULL, its lines from offset from on (the ones that haven't
+ * been indexed yet, for a file that's still being indexed) are written after
+ * the rows in the same way, so that the file can be saved whole without
+ * indexing the rest of it first. Only rest's mapping is read, not its index.
+ *
+ * Sets written to the number of bytes written. Returns false (with errno
+ * set) if a write fails.
+ */
+bool writeRows(int fileDescriptor, RowTree *rows, MappedFile *rest,
+               size_t from, size_t *written);
+
+/**
+ * Save rows to filename: write them to a new file next to it, flush it to
+ * disk, and rename it over filename, so that a crash leaves either the old
+ * contents or the new ones. rest and from are as for writeRows. The old
+ * file isn't written to, which matters because rows from a mapped file point
+ * into it. If filename is a symbolic link, the file it points to is the one
+ * replaced, and the link is left as it was. The file keeps its permissions,
+ * and its owner and group as far as we're allowed to give them to it (see
+ * chown). Returns false (with errno set) on failure, leaving filename as it
+ * was.
+ */
+bool saveRows(const char *filename, RowTree *rows, MappedFile *rest,
+              size_t from, size_t *written);
+
+/**
+ * Write rope to fileDescriptor as it is (it has its own newlines), its
+ * chunks gathered for writev as writeRows gathers lines. Chunks that are
+ * next to each other in memory, as the untouched parts of a mapped file are,
+ * go out as one slice.
+ */
+bool writeRope(int fileDescriptor, Rope *rope, size_t *written);
+
+/**
+ * Save rope to filename, the way saveRows saves rows.
+ */
+bool saveRope(const char *filename, Rope *rope, size_t *written);
+
+typedef struct Save Save;
+
+/**
+ * A save running on a thread of its own, so that editing can carry on while
+ * a big file is written. It writes a snapshot of the rows (or rope): both are
+ * persistent, so edits made meanwhile make new versions and leave the
+ * snapshot as it was.
+ *
+ * rows: The snapshot. Taken and given up on the thread that started the
+ *   save, since reference counts aren't atomic; the save thread only reads
+ *   it.
+ * rest, from: The part of a file still being indexed that comes after rows
+ *   (see writeRows), or NULL. Retained and released like rows. rows' leaves
+ *   read their lines through rest's index, so it's marked as saving, which
+ *   stops it being indexed any further (and its index being moved) until
+ *   the save has been waited for.
+ * rope: For a buffer that keeps its text in a rope, the snapshot of that
+ *   instead of rows (see saveRopeInBackground), retained and released like
+ *   rows, or NULL.
+ * threaded: Whether the save got a thread. If one couldn't be made, the
+ *   save has already been done, on the thread that started it.
+ * finished: Set by the save thread once it's done, at which point saved,
+ *   written and error hold the result (error being errno if it failed).
+ */
+struct Save {
+  pthread_t thread;
+  bool threaded;
+  char *filename;
+  RowTree *rows;
+  MappedFile *rest;
+  size_t from;
+  Rope *rope;
+  bool saved;
+  size_t written;
+  int error;
+  atomic_bool finished;
+};
+
+/**
+ * Start saving rows, then the lines of rest from from on, to filename (as
+ * saveRows) on a new thread. Takes a reference to rows and rest, marks rest
+ * as saving, and unpacks any of rows' leaves that are packed first.
+ */
+Save *saveInBackground(const char *filename, RowTree *rows, MappedFile *rest,
+                       size_t from);
+
+/**
+ * Start saving rope to filename (as saveRope) on a new thread. Takes a
+ * reference to rope.
+ */
+Save *saveRopeInBackground(const char *filename, Rope *rope);
+
+/**
+ * Whether save has finished, without waiting for it.
+ */
+bool saveFinished(Save *save);
+
+/**
+ * Wait for save to finish, then free it. Returns whether it saved, with
+ * written set to the number of bytes written, or errno set if it failed.
+ */
+bool saveWait(Save *save, size_t *written);
+
+#endif
@@ -0,0 +1,451 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "screen.h"
+
+/**
+ * Most unchanged cells between two changed runs in a row that are sent
+ * again, rather than moving the cursor over them (which takes about as many
+ * bytes).
+ */
+#define SCREEN_GAP 8
+
+/**
+ * Fewest blanks in a row that are sent as an erase and a cursor move rather
+ * than as spaces.
+ */
+#define SCREEN_BLANK_RUN 12
+
+/**
+ * Where the terminal's cursor is and what attributes it's drawing with, as
+ * a flush goes along. y is -1 when the cursor could be anywhere.
+ */
+typedef struct Pen {
+  int y;
+  int x;
+  unsigned char attributes;
+} Pen;
+
+void screenResize(Screen *screen, int height, int width) {
+  if (height < 0) height = 0;
+  if (width < 0) width = 0;
+  if (height == screen->height && width == screen->width && screen->text != NULL) {
+    return;
+  }
+  free(screen->text);
+  free(screen->attributes);
+  free(screen->shownText);
+  free(screen->shownAttributes);
+  size_t count = (size_t)height * width;
+  // never zero, so a grid of nothing still counts as allocated
+  screen->text = malloc(count + 1);
+  screen->attributes = malloc(count + 1);
+  screen->shownText = malloc(count + 1);
+  screen->shownAttributes = malloc(count + 1);
+  screen->height = height;
+  screen->width = width;
+  screen->valid = false;
+  screenStart(screen);
+}
+
+void screenInvalidate(Screen *screen) {
+  screen->valid = false;
+}
+
+void screenStart(Screen *screen) {
+  size_t count = (size_t)screen->height * screen->width;
+  memset(screen->text, ' ', count);
+  memset(screen->attributes, 0, count);
+  screen->y = 0;
+  screen->x = 0;
+  screen->pen = 0;
+  screen->scrollCount = 0;
+}
+
+static void screenAttribute(Screen *screen, int parameter) {
+  if (parameter == 0) {
+    screen->pen = 0;
+  } else if (parameter == 7) {
+    screen->pen |= CELL_REVERSE;
+  } else if (parameter == 27) {
+    screen->pen &= ~CELL_REVERSE;
+  }
+}
+
+/**
+ * Draw length characters from the current position: s, or if s is NULL,
+ * spaces.
+ */
+static void screenPut(Screen *screen, const char *s, int length) {
+  if (length <= 0) {
+    return;
+  }
+  if (screen->y < screen->height && screen->x < screen->width) {
+    int count = screen->width - screen->x;
+    if (length < count) count = length;
+    size_t at = (size_t)screen->y * screen->width + screen->x;
+    if (s == NULL) {
+      memset(screen->text + at, ' ', count);
+    } else {
+      memcpy(screen->text + at, s, count);
+    }
+    memset(screen->attributes + at, screen->pen, count);
+  }
+  screen->x += length;
+}
+
+/**
+ * Take in the escape sequence at s[i], returning where the text after it
+ * starts.
+ */
+static int screenEscape(Screen *screen, const char *s, int i, int length) {
+  if (i + 1 == length || s[i + 1] != '[') {
+    screenPut(screen, s + i, 1);
+    return i + 1;
+  }
+  int start = i + 2;
+  int end = start;
+  while (end < length && (s[end] < 0x40 || s[end] > 0x7e)) {
+    end++;
+  }
+  if (end == length) {
+    return length;
+  }
+  if (s[end] == 'm') {
+    int parameter = 0;
+    for (int j = start; j <= end; j++) {
+      if (s[j] >= '0' && s[j] <= '9') {
+        parameter = parameter * 10 + s[j] - '0';
+      } else {
+        screenAttribute(screen, parameter);
+        parameter = 0;
+      }
+    }
+  }
+  return end + 1;
+}
+
+void screenWrite(Screen *screen, const char *s, int length) {
+  int i = 0;
+  while (i < length) {
+    const char *escape = memchr(s + i, '\x1b', length - i);
+    int plain = escape == NULL ? length - i : escape - (s + i);
+    screenPut(screen, s + i, plain);
+    i += plain;
+    if (i < length) {
+      i = screenEscape(screen, s, i, length);
+    }
+  }
+}
+
+void screenBlanks(Screen *screen, int n) {
+  screenPut(screen, NULL, n);
+}
+
+void screenNewline(Screen *screen) {
+  screen->y++;
+  screen->x = 0;
+  screen->pen = 0;
+}
+
+/**
+ * Eight bytes from p, read as one word.
+ */
+static uint64_t word(const void *p) {
+  uint64_t w;
+  memcpy(&w, p, 8);
+  return w;
+}
+
+#define BYTES(b) (UINT64_C(0x0101010101010101) * (b))
+
+/**
+ * Whether every character of text takes up one column on the terminal.
+ * Rows with anything else (UTF-8, control characters) can't be patched a
+ * cell at a time, since cells don't line up with columns.
+ *
+ * Goes a word at a time: a byte below ' ' borrows its top bit when ' ' is
+ * taken away, and one above '~' carries into it when 0x80 - 0x7f is added.
+ */
+static bool plainRow(const char *text, int width) {
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint64_t w = word(text + x);
+    if (((w - BYTES(0x20)) & ~w) & BYTES(0x80)) return false;
+    if (((w + BYTES(0x01)) | w) & BYTES(0x80)) return false;
+  }
+  for (; x < width; x++) {
+    if (text[x] < ' ' || text[x] > '~') {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * The first cell from x on, up to width, that differs between a row and
+ * what's shown of it, or width if there isn't one.
+ */
+static int nextChange(const char *text, const unsigned char *attributes,
+                      const char *wasText, const unsigned char *wasAttributes,
+                      int x, int width) {
+  while (x + 8 <= width && word(text + x) == word(wasText + x)
+         && word(attributes + x) == word(wasAttributes + x)) {
+    x += 8;
+  }
+  while (x < width && text[x] == wasText[x] && attributes[x] == wasAttributes[x]) {
+    x++;
+  }
+  return x;
+}
+
+/**
+ * Write n in decimal at span, returning how many digits that took.
+ */
+static int writeNumber(char *span, int n) {
+  char digits[12];
+  int length = 0;
+  do {
+    digits[length++] = '0' + n % 10;
+    n /= 10;
+  } while (n > 0);
+  for (int i = 0; i < length; i++) {
+    span[i] = digits[length - 1 - i];
+  }
+  return length;
+}
+
+/**
+ * Append the control sequence with the parameter first (and second, unless
+ * it's negative) and the final byte final, e.g. a cursor move.
+ */
+static void appendSequence(struct abuf *out, int first, int second, char final) {
+  char *span = abReserve(out, 32);
+  if (span == NULL) {
+    return;
+  }
+  int length = 2;
+  span[0] = '\x1b';
+  span[1] = '[';
+  length += writeNumber(span + length, first);
+  if (second >= 0) {
+    span[length++] = ';';
+    length += writeNumber(span + length, second);
+  }
+  span[length++] = final;
+  abCommit(out, length);
+}
+
+static void moveTo(Pen *pen, struct abuf *out, int y, int x) {
+  if (pen->y == y && pen->x == x) {
+    return;
+  }
+  appendSequence(out, y + 1, x + 1, 'H');
+  pen->y = y;
+  pen->x = x;
+}
+
+static void setAttributes(Pen *pen, struct abuf *out, unsigned char attributes) {
+  if (attributes == pen->attributes) {
+    return;
+  }
+  if (attributes & CELL_REVERSE) {
+    abAppend(out, "\x1b[7m", 4);
+  } else {
+    abAppend(out, "\x1b[27m", 5);
+  }
+  pen->attributes = attributes;
+}
+
+/**
+ * Blank the next count cells, leaving the cursor after them.
+ */
+static void eraseCharacters(struct abuf *out, int count) {
+  appendSequence(out, count, -1, 'X');
+  appendSequence(out, count, -1, 'C');
+}
+
+/**
+ * Send the cells of a row from from up to to, starting at the cursor.
+ */
+static void sendCells(Pen *pen, struct abuf *out, bool erase, const char *text,
+                      const unsigned char *attributes, int from, int to) {
+  int x = from;
+  while (x < to) {
+    // a run of cells with the same attributes
+    setAttributes(pen, out, attributes[x]);
+    int end = x + 1;
+    while (end < to && attributes[end] == attributes[x]) {
+      end++;
+    }
+    bool eraseBlanks = erase && attributes[x] == 0;
+    int sent = x;
+    while (x < end) {
+      int blanks = 0;
+      while (eraseBlanks && x + blanks < end && text[x + blanks] == ' ') {
+        blanks++;
+      }
+      if (blanks >= SCREEN_BLANK_RUN) {
+        abAppend(out, text + sent, x - sent);
+        eraseCharacters(out, blanks);
+        sent = x + blanks;
+      }
+      x += blanks > 0 ? blanks : 1;
+    }
+    abAppend(out, text + sent, end - sent);
+  }
+  if (to > from) pen->x += to - from;
+}
+
+/**
+ * Blank the rest of the row from the cursor on.
+ */
+static void eraseRest(Pen *pen, struct abuf *out) {
+  setAttributes(pen, out, 0);
+  abAppend(out, "\x1b[K", 3);
+}
+
+void screenScroll(Screen *screen, int top, int bottom, int left, int width, int delta) {
+  if (top < 0) top = 0;
+  if (bottom > screen->height) bottom = screen->height;
+  if (left > 0 || left + width < screen->width || delta == 0
+      || abs(delta) >= bottom - top || screen->scrollCount == SCREEN_SCROLLS) {
+    return;
+  }
+  screen->scrolls[screen->scrollCount++] = (ScreenScroll){top, bottom, delta};
+}
+
+/**
+ * How many rows of scroll would already be showing if what's shown were
+ * moved delta rows.
+ */
+static int scrolledRows(Screen *screen, const ScreenScroll *scroll, int delta) {
+  int width = screen->width;
+  int rows = 0;
+  for (int y = scroll->top; y < scroll->bottom; y++) {
+    int from = y + delta;
+    if (from < scroll->top || from >= scroll->bottom) {
+      continue;
+    }
+    size_t at = (size_t)y * width;
+    size_t shownAt = (size_t)from * width;
+    if (memcmp(screen->text + at, screen->shownText + shownAt, width) == 0
+        && memcmp(screen->attributes + at, screen->shownAttributes + shownAt, width) == 0) {
+      rows++;
+    }
+  }
+  return rows;
+}
+
+/**
+ * Have the terminal scroll the rows of scroll, and what's shown along with
+ * them: the rows are set as the scrolling region (which sends the cursor
+ * home), and the cursor moved to the bottom of it and down a line (IND) for
+ * each row to scroll up, or to the top and up a line (RI) to scroll down.
+ * The rows that scroll into view are blank.
+ */
+static void scrollRows(Screen *screen, Pen *pen, struct abuf *out,
+                       const ScreenScroll *scroll) {
+  int width = screen->width;
+  int count = abs(scroll->delta);
+  appendSequence(out, scroll->top + 1, scroll->bottom, 'r');
+  pen->y = 0;
+  pen->x = 0;
+  moveTo(pen, out, scroll->delta > 0 ? scroll->bottom - 1 : scroll->top, 0);
+  for (int i = 0; i < count; i++) {
+    abAppend(out, scroll->delta > 0 ? "\x1b" "D" : "\x1b" "M", 2);
+  }
+  abAppend(out, "\x1b[r", 3);
+  pen->y = 0;
+  pen->x = 0;
+
+  int kept = scroll->bottom - scroll->top - count;
+  int to = scroll->delta > 0 ? scroll->top : scroll->top + count;
+  int from = scroll->delta > 0 ? scroll->top + count : scroll->top;
+  int blank = scroll->delta > 0 ? scroll->top + kept : scroll->top;
+  memmove(screen->shownText + (size_t)to * width,
+          screen->shownText + (size_t)from * width, (size_t)kept * width);
+  memmove(screen->shownAttributes + (size_t)to * width,
+          screen->shownAttributes + (size_t)from * width, (size_t)kept * width);
+  memset(screen->shownText + (size_t)blank * width, ' ', (size_t)count * width);
+  memset(screen->shownAttributes + (size_t)blank * width, 0, (size_t)count * width);
+}
+
+void screenFlush(Screen *screen, struct abuf *out) {
+  int width = screen->width;
+  size_t count = (size_t)screen->height * width;
+  Pen pen = {-1, -1, 0};
+  if (!screen->valid) {
+    abAppend(out, "\x1b[2J", 4);
+    memset(screen->shownText, ' ', count);
+    memset(screen->shownAttributes, 0, count);
+    screen->valid = true;
+  } else if (screen->scrollRegions) {
+    for (int i = 0; i < screen->scrollCount; i++) {
+      const ScreenScroll *scroll = &screen->scrolls[i];
+      if (scrolledRows(screen, scroll, scroll->delta) > scrolledRows(screen, scroll, 0)) {
+        scrollRows(screen, &pen, out, scroll);
+      }
+    }
+  }
+  for (int y = 0; y < screen->height; y++) {
+    size_t at = (size_t)y * width;
+    const char *text = screen->text + at;
+    const unsigned char *attributes = screen->attributes + at;
+    const char *wasText = screen->shownText + at;
+    const unsigned char *wasAttributes = screen->shownAttributes + at;
+    if (memcmp(text, wasText, width) == 0
+        && memcmp(attributes, wasAttributes, width) == 0) {
+      continue;
+    }
+    // the row is blank from end on
+    int end = width;
+    while (end >= 8 && word(text + end - 8) == BYTES(' ')
+           && word(attributes + end - 8) == 0) {
+      end -= 8;
+    }
+    while (end > 0 && text[end - 1] == ' ' && attributes[end - 1] == 0) {
+      end--;
+    }
+    if (!plainRow(text, end) || !plainRow(wasText, width)) {
+      moveTo(&pen, out, y, 0);
+      sendCells(&pen, out, screen->eraseCharacters, text, attributes, 0, end);
+      if (end < width) {
+        eraseRest(&pen, out);
+      }
+      pen.y = -1;
+      continue;
+    }
+    int x = nextChange(text, attributes, wasText, wasAttributes, 0, width);
+    while (x < width) {
+      // a run of changes, taking in short stretches of unchanged cells
+      int last = x;
+      int next = nextChange(text, attributes, wasText, wasAttributes, x + 1, width);
+      while (next < width && next - last <= SCREEN_GAP) {
+        last = next;
+        next = nextChange(text, attributes, wasText, wasAttributes, next + 1, width);
+      }
+      moveTo(&pen, out, y, x);
+      if (last >= end) {
+        sendCells(&pen, out, screen->eraseCharacters, text, attributes, x, end);
+        eraseRest(&pen, out);
+        break;
+      }
+      sendCells(&pen, out, screen->eraseCharacters, text, attributes, x, last + 1);
+      x = next;
+    }
+  }
+  setAttributes(&pen, out, 0);
+  memcpy(screen->shownText, screen->text, count);
+  memcpy(screen->shownAttributes, screen->attributes, count);
+}
+
+void screenFree(Screen *screen) {
+  free(screen->text);
+  free(screen->attributes);
+  free(screen->shownText);
+  free(screen->shownAttributes);
+  *screen = (Screen){0};
+}
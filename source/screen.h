@@ -0,0 +1,125 @@
+#ifndef SCREEN
+#define SCREEN
+
+#include <stdbool.h>
+
+#include "appendBuffer.h"
+
+/**
+ * Bits of a cell's attributes.
+ */
+#define CELL_REVERSE 1
+
+/**
+ * Most scrolls screenScroll keeps for a frame; any more are drawn as they
+ * are.
+ */
+#define SCREEN_SCROLLS 4
+
+/**
+ * Rows top up to bottom of a frame show what was shown delta rows further
+ * down (or up, if delta is negative), for screenFlush to scroll rather than
+ * draw again.
+ */
+typedef struct ScreenScroll {
+  int top;
+  int bottom;
+  int delta;
+} ScreenScroll;
+
+/**
+ * The terminal as a grid of cells. A frame is drawn into the grid, then
+ * screenFlush compares it with the frame before (shown) and sends the
+ * terminal only the runs of cells that changed, so typing a character costs
+ * a cursor move and a few characters rather than a redraw of every pane.
+ *
+ * The characters and attributes of the cells are kept apart, a row after
+ * another, so that drawing a row is a memcpy and a memset, and sending one
+ * is a memcpy straight out of text.
+ *
+ * height, width: Size of the grid.
+ * text, attributes: The frame being drawn.
+ * shownText, shownAttributes: What the terminal has on it, as far as we
+ *   know.
+ * valid: Whether shown can be trusted. If not (the first frame, after a
+ *   resize, or after something else has written to the terminal), the next
+ *   flush clears the terminal and draws everything.
+ * eraseCharacters: Whether the terminal can erase characters without
+ *   moving the cursor (ECH, from the VT220 on), so runs of blanks in the
+ *   middle of a row can be sent as an erase and a cursor move.
+ * scrollRegions: Whether the terminal can scroll some of its rows (DECSTBM,
+ *   from the VT100 on), so that scrolling a pane by a line sends a line
+ *   rather than all of them.
+ * scrolls: The scrolls screenScroll has been told about this frame.
+ * y, x, pen: Where the next character drawn goes, and its attributes.
+ */
+typedef struct Screen {
+  int height;
+  int width;
+  char *text;
+  unsigned char *attributes;
+  char *shownText;
+  unsigned char *shownAttributes;
+  bool valid;
+  bool eraseCharacters;
+  bool scrollRegions;
+  ScreenScroll scrolls[SCREEN_SCROLLS];
+  int scrollCount;
+  int y;
+  int x;
+  unsigned char pen;
+} Screen;
+
+/**
+ * Make the grid height rows by width columns, forgetting what's shown if
+ * that's a change.
+ */
+void screenResize(Screen *screen, int height, int width);
+
+/**
+ * Forget what the terminal shows, so the next flush redraws all of it.
+ */
+void screenInvalidate(Screen *screen);
+
+/**
+ * Start a new frame: blank, with drawing starting at the top left.
+ */
+void screenStart(Screen *screen);
+
+/**
+ * Draw length bytes of s from the current position. SGR sequences ("\x1b[7m"
+ * and so on) change the attributes of the characters after them rather than
+ * taking up cells; other escape sequences are dropped. Anything past the
+ * right edge is cut off.
+ */
+void screenWrite(Screen *screen, const char *s, int length);
+
+/**
+ * Draw n spaces.
+ */
+void screenBlanks(Screen *screen, int n);
+
+/**
+ * Carry on drawing at the start of the next row, with no attributes.
+ */
+void screenNewline(Screen *screen);
+
+/**
+ * Note that the width columns from left of rows top up to bottom of this
+ * frame show what was shown delta rows further down (a negative delta is
+ * up), as when a pane there scrolls. screenFlush checks, and if it would
+ * save sending them, has the terminal scroll the rows and only sends the
+ * ones that scrolled into view. Terminals scroll whole rows, so rows that
+ * are shared with something else aren't scrolled.
+ */
+void screenScroll(Screen *screen, int top, int bottom, int left, int width, int delta);
+
+/**
+ * Append to out what it takes to turn what's shown into the frame that's
+ * been drawn, which is then what's shown.
+ */
+void screenFlush(Screen *screen, struct abuf *out);
+
+void screenFree(Screen *screen);
+
+#endif
@@ -0,0 +1,131 @@
+#include <string.h>
+#include "tabs.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TABS_X86
+#include <immintrin.h>
+#endif
+
+static size_t scalarCount(const char *s, size_t length) {
+  size_t tabs = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (s[i] == '\t') {
+      tabs++;
+    }
+  }
+  return tabs;
+}
+
+static size_t scalarFind(const char *s, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (s[i] == '\t') {
+      return i;
+    }
+  }
+  return length;
+}
+
+const TabKernels scalarTabKernels = {"scalar", scalarCount, scalarFind};
+
+#ifdef TABS_X86
+
+__attribute__((target("sse2")))
+static size_t sse2Count(const char *s, size_t length) {
+  const __m128i tab = _mm_set1_epi8('\t');
+  size_t tabs = 0;
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    tabs += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, tab)));
+  }
+  return tabs + scalarCount(s + i, length - i);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2Find(const char *s, size_t length) {
+  const __m128i tab = _mm_set1_epi8('\t');
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(s + i));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, tab));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + scalarFind(s + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2Count(const char *s, size_t length) {
+  const __m256i tab = _mm256_set1_epi8('\t');
+  size_t tabs = 0;
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + i));
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, tab));
+    tabs += __builtin_popcount(mask);
+  }
+  return tabs + sse2Count(s + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2Find(const char *s, size_t length) {
+  const __m256i tab = _mm256_set1_epi8('\t');
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + i));
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, tab));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return i + sse2Find(s + i, length - i);
+}
+
+static const TabKernels sse2TabKernels = {"sse2", sse2Count, sse2Find};
+
+static const TabKernels avx2TabKernels = {"avx2", avx2Count, avx2Find};
+
+#endif
+
+const TabKernels *tabKernels(void) {
+  static const TabKernels *kernels = NULL;
+  if (kernels == NULL) {
+    kernels = &scalarTabKernels;
+#ifdef TABS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      kernels = &avx2TabKernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+      kernels = &sse2TabKernels;
+    }
+#endif
+  }
+  return kernels;
+}
+
+size_t countTabs(const char *s, size_t length) {
+  return tabKernels()->count(s, length);
+}
+
+size_t findTab(const char *s, size_t length) {
+  return tabKernels()->find(s, length);
+}
+
+size_t expandTabs(const char *s, size_t length, int tabSize, char *out) {
+  size_t (*find)(const char *, size_t) = tabKernels()->find;
+  char *start = out;
+  size_t i = 0;
+  while (i < length) {
+    size_t run = find(s + i, length - i);
+    memcpy(out, s + i, run);
+    out += run;
+    i += run;
+    if (i < length) {
+      memset(out, ' ', tabSize);
+      out += tabSize;
+      i++;
+    }
+  }
+  return out - start;
+}
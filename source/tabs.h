@@ -0,0 +1,39 @@
+#ifndef TABS
+#define TABS
+
+#include <stddef.h>
+
+/**
+ * Ways of scanning text for tabs. There's a portable version, and on x86 ones
+ * using SSE2 and AVX2 which look at 16 or 32 characters at a time.
+ *
+ * name: For benchmarks and the like.
+ * count: Number of tabs in the first length characters of s.
+ * find: Index of the first tab in the first length characters of s, or
+ *   length if there isn't one.
+ */
+typedef struct TabKernels {
+  const char *name;
+  size_t (*count)(const char *s, size_t length);
+  size_t (*find)(const char *s, size_t length);
+} TabKernels;
+
+extern const TabKernels scalarTabKernels;
+
+/**
+ * The fastest kernels this CPU supports, picked the first time it's called.
+ */
+const TabKernels *tabKernels(void);
+
+size_t countTabs(const char *s, size_t length);
+
+size_t findTab(const char *s, size_t length);
+
+/**
+ * Copy the first length characters of s to out, with each tab replaced by
+ * tabSize spaces, and return the number of characters written. out must have
+ * room for length + countTabs(s, length) * (tabSize - 1) characters.
+ */
+size_t expandTabs(const char *s, size_t length, int tabSize, char *out);
+
+#endif
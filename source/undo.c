@@ -1,15 +1,32 @@
+#include "pool.h"
 #include "undo.h"
 
-UndoStack *undoCons(RowList *forwards,
-                    RowList *backwards,
-                    int cursorX,
-                    int cursorY,
+static Pool entries = POOL_INIT(UndoStack);
+
+UndoStack *undoCons(RowTree *rows,
+                    Rope *rope,
+                    int64_t cursorX,
+                    int64_t cursorY,
                     UndoStack *tail) {
-  UndoStack *new = malloc(sizeof(*new));
+  UndoStack *new = poolAlloc(&entries);
   new->tail = tail;
-  new->forwards = forwards;
-  new->backwards = backwards;
+  new->rows = rowTreeRetain(rows);
+  new->rope = ropeRetain(rope);
   new->cursorX = cursorX;
   new->cursorY = cursorY;
   return new;
 }
+
+void undoAppendLines(UndoStack *stack, MappedFile *file, int64_t from, int64_t to) {
+  for (; stack != NULL; stack = stack->tail) {
+    RowTree *rows = rowTreeAppendLines(stack->rows, file, from, to);
+    rowTreeRelease(stack->rows);
+    stack->rows = rows;
+  }
+}
+
+void undoFree(UndoStack *entry) {
+  rowTreeRelease(entry->rows);
+  ropeRelease(entry->rope);
+  poolFree(&entries, entry);
+}
@@ -5,19 +5,34 @@
 
 typedef struct UndoStack UndoStack;
 
+/**
+ * Each entry holds a reference to its version of the rows, or of the rope
+ * for a buffer that keeps its text in one.
+ */
 struct UndoStack {
-  RowList *forwards;
-  RowList *backwards;
-  int cursorX;
-  int cursorY;
+  RowTree *rows;
+  Rope *rope;
+  int64_t cursorX;
+  int64_t cursorY;
   UndoStack *tail;
 };
 
 
-UndoStack *undoCons(RowList *forwards,
-                    RowList *backwards,
-                    int cursorX,
-                    int cursorY,
+UndoStack *undoCons(RowTree *rows,
+                    Rope *rope,
+                    int64_t cursorX,
+                    int64_t cursorY,
                     UndoStack *tail);
 
+/**
+ * Add lines from to to of file after the last row of every entry of stack,
+ * e.g. because they've just been indexed.
+ */
+void undoAppendLines(UndoStack *stack, MappedFile *file, int64_t from, int64_t to);
+
+/**
+ * Free the top entry of a stack (not the rest of it), letting go of its rows.
+ */
+void undoFree(UndoStack *entry);
+
 #endif
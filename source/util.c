@@ -1,4 +1,6 @@
-int clip(int x, int min, int max) {
+#include "util.h"
+
+int64_t clip(int64_t x, int64_t min, int64_t max) {
   if (x <= min) {
     return min;
   } else if (x >= max) {
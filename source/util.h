@@ -1,2 +1,5 @@
 #pragma once
-int clip(int x, int min, int max);
+
+#include <stdint.h>
+
+int64_t clip(int64_t x, int64_t min, int64_t max);
@@ -1,182 +1,314 @@
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "editorRow.h"
+#include "gapBuffer.h"
+#include "rope.h"
+#include "rowTree.h"
+#include "util.h"
 #include "zipperBuffer.h"
 
-RowList *rowListDrop(RowList *list, int n) {
-  if (n <= 0) {
-    return list;
-  } else {
-    return rowListDrop(list->tail, n - 1);
-  }
+ZipperBuffer *zipperBuffer(RowTree *rows, int64_t cursor) {
+  ZipperBuffer *buffer = malloc(sizeof(ZipperBuffer));
+  buffer->rows = NULL;
+  buffer->open = NULL;
+  buffer->isRope = false;
+  buffer->rope = NULL;
+  buffer->tabSize = 0;
+  buffer->typing = false;
+  buffer->current = NULL;
+  buffer->previous = NULL;
+  zipperSetRows(buffer, rows, cursor);
+  return buffer;
 }
 
-int rowListId = 0;
+ZipperBuffer *zipperRopeBuffer(Rope *rope, int64_t cursor, int tabSize) {
+  ZipperBuffer *buffer = zipperBuffer(NULL, 0);
+  buffer->isRope = true;
+  buffer->tabSize = tabSize;
+  zipperSetRope(buffer, rope, cursor);
+  return buffer;
+}
+
+bool zipperIsRope(ZipperBuffer *buffer) {
+  return buffer->isRope;
+}
 
-RowList *rowListCons(EditorRow *head, RowList *tail) {
-  RowList *rowList = malloc(sizeof(RowList));
-  rowList->head = head;
-  rowList->tail = tail;
-  rowList->number = rowListId++;
-  return rowList;
+int64_t zipperLength(ZipperBuffer *buffer) {
+  if (buffer->isRope) return ropeLines(buffer->rope) - 1;
+  return rowTreeLength(buffer->rows);
 }
 
 /**
- * True if x is newer than y, false otherwise.
+ * Let go of the rows made from a rope, since the rope or the cursor has
+ * changed.
  */
-bool rowListNewer(RowList *x, RowList *y) {
-  if (y == NULL) {
-    return true;
-  } else if (x == NULL) {
-    return false;
-  } else {
-    return x->number > y->number;
+static void zipperForget(ZipperBuffer *buffer) {
+  if (buffer->current != NULL) editorReleaseRow(buffer->current);
+  if (buffer->previous != NULL) editorReleaseRow(buffer->previous);
+  buffer->current = NULL;
+  buffer->previous = NULL;
+}
+
+void zipperSetRows(ZipperBuffer *buffer, RowTree *rows, int64_t cursor) {
+  zipperCloseRow(buffer);
+  rowTreeRetain(rows);
+  rowTreeRelease(buffer->rows);
+  buffer->rows = rows;
+  buffer->leaf = NULL;
+  zipperJumpTo(buffer, cursor);
+}
+
+void zipperSetRope(ZipperBuffer *buffer, Rope *rope, int64_t cursor) {
+  zipperCloseRow(buffer);
+  ropeRetain(rope);
+  ropeRelease(buffer->rope);
+  buffer->rope = rope;
+  zipperForget(buffer);
+  zipperJumpTo(buffer, cursor);
+}
+
+/**
+ * Replace the rope with a new version, which the buffer takes over the
+ * reference to.
+ */
+static void zipperUpdateRope(ZipperBuffer *buffer, Rope *rope) {
+  ropeRelease(buffer->rope);
+  buffer->rope = rope;
+  zipperForget(buffer);
+}
+
+/**
+ * Insert length bytes of s into the rope before byte at.
+ */
+static void zipperRopeInsert(ZipperBuffer *buffer, size_t at, const char *s,
+                             size_t length) {
+  zipperUpdateRope(buffer, ropeInsert(buffer->rope, at, s, length));
+}
+
+static void zipperRopeDelete(ZipperBuffer *buffer, size_t at, size_t length) {
+  zipperUpdateRope(buffer, ropeDelete(buffer->rope, at, length));
+}
+
+/**
+ * The row at index of a rope, from cache if it's been made already (and into
+ * cache if it hasn't).
+ */
+static EditorRow *zipperRopeRow(ZipperBuffer *buffer, int64_t index, EditorRow **cache) {
+  if (index < 0 || index >= zipperLength(buffer)) return NULL;
+  if (*cache == NULL) {
+    size_t start = ropeLineStart(buffer->rope, index);
+    size_t length = ropeLineEnd(buffer->rope, index) - start;
+    char *chars = malloc(length + 1);
+    ropeCopy(buffer->rope, start, length, chars);
+    chars[length] = '\0';
+    *cache = editorRetainRow(newRow(chars, length, buffer->tabSize));
   }
+  return *cache;
+}
+
+/**
+ * Put a row's characters and a newline into the rope before byte at. The
+ * rope keeps a copy, so the row is freed unless something else holds it.
+ */
+static void zipperRopeInsertRow(ZipperBuffer *buffer, size_t at, EditorRow *r) {
+  editorRetainRow(r);
+  zipperRopeInsert(buffer, at, "\n", 1);
+  zipperRopeInsert(buffer, at, r->chars, r->size);
+  editorReleaseRow(r);
+}
+
+/**
+ * Replace the rows with a new version, which the buffer takes over the
+ * reference to.
+ */
+static void zipperUpdate(ZipperBuffer *buffer, RowTree *rows) {
+  rowTreeRelease(buffer->rows);
+  buffer->rows = rows;
+  buffer->leaf = NULL;
 }
 
-void updateRowList(RowList *toUpdate, EditorRow *newHead, RowList *newTail) {
-  if (toUpdate == NULL) return;
-  toUpdate->head = newHead;
-  toUpdate->tail = newTail;
-  toUpdate->number = rowListId++;
+void zipperAppendLines(ZipperBuffer *buffer, MappedFile *file, int64_t from, int64_t to) {
+  if (buffer->isRope) return;
+  zipperUpdate(buffer, rowTreeAppendLines(buffer->rows, file, from, to));
 }
 
 /**
- * Reverses a RowList in-place. Returns the new head.
+ * The row at index, from the cached leaf if it's there.
  */
-RowList *rowListReverse(RowList *rows) {
-  RowList *last = NULL;
-  RowList *next = NULL;
-  while (rows != NULL) {
-    next = rows->tail;
-    rows->tail = last;
-    last = rows;
-    rows = next;
+static EditorRow *zipperRowAt(ZipperBuffer *buffer, int64_t index) {
+  if (buffer->leaf == NULL || index < buffer->leafStart ||
+      index >= buffer->leafStart + buffer->leaf->count) {
+    buffer->leaf = rowTreeLeaf(buffer->rows, index, &buffer->leafStart);
+    if (buffer->leaf == NULL) return NULL;
   }
-  return last;
+  return rowTreeLeafRow(buffer->leaf, index - buffer->leafStart);
 }
 
 void zipperForwardRow(ZipperBuffer *buffer) {
-  if (buffer->forwards == NULL) return;
-  RowList *oldForwards = buffer->forwards;
-  RowList *newForwards = buffer->forwards->tail;
-  RowList *oldBackwards = buffer->backwards;
-  RowList *newBackwards = rowListCons(oldForwards->head, oldBackwards);
-  if (rowListNewer(oldForwards, buffer->newest)) {
-    free(oldForwards);
-  }
-  buffer->forwards = newForwards;
-  buffer->backwards = newBackwards;
+  zipperForwardN(buffer, 1);
 }
 
-void zipperForwardN(ZipperBuffer *buffer, int n) {
-  for (;n > 0; n--) {
-    zipperForwardRow(buffer);
-  }
+void zipperForwardN(ZipperBuffer *buffer, int64_t n) {
+  zipperJumpTo(buffer, buffer->cursor + n);
 }
 
 void zipperBackwardRow(ZipperBuffer *buffer) {
-  if (buffer->backwards == NULL) return;
-  RowList *oldBackwards = buffer->backwards;
-  RowList *newBackwards = buffer->backwards->tail;
-  RowList *oldForwards = buffer->forwards;
-  RowList *newForwards = rowListCons(oldBackwards->head, oldForwards);
-  if (rowListNewer(oldBackwards, buffer->newest)) {
-    free(oldBackwards);
+  zipperBackwardN(buffer, 1);
+}
+
+void zipperBackwardN(ZipperBuffer *buffer, int64_t n) {
+  zipperJumpTo(buffer, buffer->cursor - n);
+}
+
+void zipperJumpTo(ZipperBuffer *buffer, int64_t index) {
+  if (index != buffer->cursor) {
+    zipperCloseRow(buffer);
+    zipperForget(buffer);
   }
-  buffer->forwards = newForwards;
-  buffer->backwards = newBackwards;
+  buffer->cursor = clip(index, 0, zipperLength(buffer));
+}
+
+EditorRow *zipperCurrentRow(ZipperBuffer *buffer) {
+  zipperCloseRow(buffer);
+  if (buffer->isRope) return zipperRopeRow(buffer, buffer->cursor, &buffer->current);
+  return zipperRowAt(buffer, buffer->cursor);
 }
 
-void zipperBackwardN(ZipperBuffer *buffer, int n) {
-  for (;n > 0; n--) {
-    zipperBackwardRow(buffer);
+int64_t zipperCurrentLength(ZipperBuffer *buffer) {
+  if (buffer->isRope) {
+    if (buffer->cursor >= zipperLength(buffer)) return -1;
+    if (buffer->current != NULL) return buffer->current->size;
+    return ropeLineEnd(buffer->rope, buffer->cursor) -
+           ropeLineStart(buffer->rope, buffer->cursor);
   }
+  if (buffer->open != NULL) return gapLength(buffer->open);
+  EditorRow *row = zipperRowAt(buffer, buffer->cursor);
+  return row == NULL ? -1 : row->size;
+}
+
+EditorRow *zipperPreviousRow(ZipperBuffer *buffer) {
+  if (buffer->isRope) return zipperRopeRow(buffer, buffer->cursor - 1, &buffer->previous);
+  return zipperRowAt(buffer, buffer->cursor - 1);
 }
 
 void zipperInsertRow(ZipperBuffer *buffer, EditorRow *r) {
-  RowList *oldForwards = buffer->forwards;
-  RowList *newForwards = rowListCons(r, oldForwards);
-  buffer->forwards = newForwards;
-  buffer->newest = newForwards;
+  zipperCloseRow(buffer);
+  if (buffer->isRope) {
+    zipperRopeInsertRow(buffer, ropeLineStart(buffer->rope, buffer->cursor), r);
+    return;
+  }
+  zipperUpdate(buffer, rowTreeInsert(buffer->rows, buffer->cursor, r));
+}
+
+void zipperAppendRow(ZipperBuffer *buffer, EditorRow *r) {
+  zipperCloseRow(buffer);
+  if (buffer->isRope) {
+    zipperRopeInsertRow(buffer, ropeLength(buffer->rope), r);
+    return;
+  }
+  zipperUpdate(buffer, rowTreeInsert(buffer->rows, zipperLength(buffer), r));
 }
 
-RowList *zipperRowsFromRelative(ZipperBuffer *buffer, int n) {
-  if (n >= 0) {
-    return rowListDrop(buffer->forwards, n);
+void zipperReplaceRow(ZipperBuffer *buffer, EditorRow *r) {
+  zipperCloseRow(buffer);
+  if (buffer->cursor == zipperLength(buffer)) {
+    zipperInsertRow(buffer, r);
+  } else if (buffer->isRope) {
+    size_t start = ropeLineStart(buffer->rope, buffer->cursor);
+    size_t end = ropeLineEnd(buffer->rope, buffer->cursor);
+    editorRetainRow(r);
+    zipperRopeDelete(buffer, start, end - start);
+    zipperRopeInsert(buffer, start, r->chars, r->size);
+    editorReleaseRow(r);
   } else {
-    zipperBackwardN(buffer, -n);
-    RowList *rows = buffer->forwards;
-    zipperUpdateNewest(buffer);
-    zipperForwardN(buffer, -n);
-    return rows;
+    zipperUpdate(buffer, rowTreeSet(buffer->rows, buffer->cursor, r));
   }
 }
 
-RowList *zipperRowsFrom(ZipperBuffer *buffer, int cursorY, int n) {
-  return zipperRowsFromRelative(buffer, n - cursorY);
+void zipperDeleteRow(ZipperBuffer *buffer, int64_t index) {
+  if (index < 0 || index >= zipperLength(buffer)) return;
+  zipperCloseRow(buffer);
+  if (buffer->isRope) {
+    size_t start = ropeLineStart(buffer->rope, index);
+    zipperRopeDelete(buffer, start, ropeLineStart(buffer->rope, index + 1) - start);
+  } else {
+    zipperUpdate(buffer, rowTreeDelete(buffer->rows, index));
+  }
+  if (index < buffer->cursor) {
+    buffer->cursor--;
+  }
 }
 
-void zipperUpdateNewest(ZipperBuffer *buffer) {
-  RowList *thisNewest = rowListNewer(buffer->forwards, buffer->backwards)
-    ? buffer->forwards
-    : buffer->backwards;
-  buffer->newest = rowListNewer(thisNewest, buffer->newest)
-    ? thisNewest
-    : buffer->newest;
+/**
+ * The current row as a gap buffer, opening it if needed.
+ */
+static GapBuffer *zipperOpenRow(ZipperBuffer *buffer, int64_t at) {
+  if (buffer->open == NULL) {
+    buffer->open = gapBuffer(zipperRowAt(buffer, buffer->cursor), at);
+  }
+  return buffer->open;
 }
 
-void printRowList(RowList *list) {
-  int i = 1;
-  while (list != NULL) {
-    printf("%d: %s\n", i, list->head->chars);
-    list = list->tail;
-    i++;
+void zipperInsertChar(ZipperBuffer *buffer, int64_t at, char c) {
+  if (buffer->isRope) {
+    buffer->typing = true;
+    zipperRopeInsert(buffer, ropeLineStart(buffer->rope, buffer->cursor) + at, &c, 1);
+    return;
   }
+  GapBuffer *gap = zipperOpenRow(buffer, at);
+  gapMoveTo(gap, at);
+  gapInsert(gap, c);
 }
 
-void printZipperBuffer(ZipperBuffer *buffer) {
-  printf("Backwards:\n");
-  printRowList(buffer->backwards);
-  printf("Forwards:\n");
-  printRowList(buffer->forwards);
-}
-
-ZipperBuffer *exampleBuffer() {
-  /* EditorRow *first = newRow("That's great, it starts with an earthquake.", 0); */
-  /* EditorRow *second = newRow("Birds and snakes, an aeroplane.", 0); */
-  /* EditorRow *third = newRow("Lenny Bruce is not afraid.", 0); */
-  /* EditorRow *fourth = newRow("Eye of a hurricane, listen to yourself churn,", 0); */
-  /* EditorRow *fifth = newRow("World serves its own needs, dummy serve your own needs", 0); */
-  /* EditorRow *sixth = newRow("Feed it off an aux speak, grunt no strength", 0); */
-  /* EditorRow *seventh = newRow("The ladder starts to clatter with fear of fight, down height", 0); */
-  /* RowList *forwards = rowListCons(first, */
-  /*   rowListCons(second, */
-  /*   rowListCons(third, */
-  /*   rowListCons(fourth, */
-  /*   rowListCons(fifth, */
-  /*   rowListCons(sixth, */
-  /*   rowListCons(seventh, NULL))))))); */
-  ZipperBuffer *buffer = malloc(sizeof(ZipperBuffer));
-  buffer->forwards = NULL;
-  buffer->backwards = NULL;
-  buffer->newest = NULL;
-  return buffer;
+void zipperDeleteChar(ZipperBuffer *buffer, int64_t at) {
+  if (buffer->isRope) {
+    buffer->typing = true;
+    if (at > 0) zipperRopeDelete(buffer, ropeLineStart(buffer->rope, buffer->cursor) + at - 1, 1);
+    return;
+  }
+  GapBuffer *gap = zipperOpenRow(buffer, at);
+  gapMoveTo(gap, at);
+  gapDelete(gap);
+}
+
+bool zipperRowIsOpen(ZipperBuffer *buffer) {
+  return buffer->isRope ? buffer->typing : buffer->open != NULL;
 }
 
-int testZipperBuffer() {
-  ZipperBuffer *buffer = exampleBuffer();
-  int i = 0;
-  printf("Starting off:\n");
-  printZipperBuffer(buffer);
-  while (1) {
-    printf("Iteration %d\n", ++i);
-    while (buffer->forwards != NULL) {
-      zipperForwardRow(buffer);
-    }
-    while (buffer->backwards != NULL) {
-      zipperBackwardRow(buffer);
-    }
+void zipperCloseRow(ZipperBuffer *buffer) {
+  buffer->typing = false;
+  if (buffer->open == NULL) return;
+  EditorRow *row = gapToRow(buffer->open);
+  gapFree(buffer->open);
+  buffer->open = NULL;
+  zipperUpdate(buffer, rowTreeSet(buffer->rows, buffer->cursor, row));
+}
+
+int64_t zipperCursorToRender(ZipperBuffer *buffer, int64_t at, int tabSize) {
+  if (buffer->isRope) {
+    if (buffer->cursor >= zipperLength(buffer)) return 0;
+    return ropeCursorToRender(buffer->rope, ropeLineStart(buffer->rope, buffer->cursor),
+                              at, tabSize);
+  }
+  if (buffer->open != NULL) {
+    gapMoveTo(buffer->open, at);
+    return gapCursorToRender(buffer->open);
+  }
+  EditorRow *row = zipperRowAt(buffer, buffer->cursor);
+  return row == NULL ? 0 : editorCursorToRender(row, at, tabSize);
+}
+
+RowIterator zipperRowsFrom(ZipperBuffer *buffer, int64_t n) {
+  return rowTreeIterate(buffer->rows, n);
+}
+
+void printZipperBuffer(ZipperBuffer *buffer) {
+  RowIterator rows = zipperRowsFrom(buffer, 0);
+  int64_t i = 0;
+  for (EditorRow *row; (row = rowIteratorNext(&rows)) != NULL; i++) {
+    printf("%s%" PRId64 ": %.*s\n", i == buffer->cursor ? "> " : "  ", i + 1, (int)row->size,
+           row->chars);
   }
 }
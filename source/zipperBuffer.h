@@ -5,59 +5,179 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include "editorRow.h"
+#include "gapBuffer.h"
+#include "rope.h"
+#include "rowTree.h"
 
-typedef struct RowList RowList;
+typedef struct ZipperBuffer ZipperBuffer;
 
-struct RowList {
-  EditorRow *head;
-  RowList *tail;
-  int number;
+/**
+ * The rows of a buffer, and the row the cursor is on.
+ *
+ * rows: The rows, as a persistent tree. Holding a reference to an old rows
+ *   pointer (as the undo history does) keeps that version of the buffer
+ *   intact.
+ * cursor: Index of the row the cursor is on. Equal to the number of rows
+ *   when the cursor is past the last row.
+ * leaf, leafStart: The leaf of rows that was last looked up and the index of
+ *   its first row, so that rows near the cursor are found without going
+ *   through the tree. NULL whenever rows changes.
+ * open: The current row while it's being typed on, or NULL. Until it's
+ *   closed (when the cursor leaves the row, or anything else reads or
+ *   changes rows), the row at cursor in rows is out of date. Moving the
+ *   cursor along the row leaves it open: see zipperCurrentLength and
+ *   zipperCursorToRender.
+ *
+ * A buffer can keep its text in a rope instead of rows (see
+ * zipperRopeBuffer), for files too big to want a row for every line that's
+ * been looked at. The operations below work on either, so the editor's edits
+ * don't need to know which it has.
+ *
+ * isRope: Whether the text is in rope rather than rows (rows is then NULL).
+ * rope: The text, whose lines are the buffer's rows. It ends in a '\n' unless
+ *   it's empty, so it has as many '\n's as the buffer has rows. Edits make a
+ *   new rope, so holding a reference to an old one (as the undo history
+ *   does) keeps that version intact, just as with rows.
+ * tabSize: Tab size of the rows made from the rope.
+ * typing: Whether a run of typing on the current row (of a rope) hasn't been
+ *   closed yet: what open says for rows.
+ * current, previous: The rows at cursor and cursor - 1 of a rope, made
+ *   when they're first asked for and held until the rope or the cursor
+ *   changes, or NULL.
+ */
+struct ZipperBuffer {
+  RowTree *rows;
+  int64_t cursor;
+  RowTree *leaf;
+  int64_t leafStart;
+  GapBuffer *open;
+  bool isRope;
+  Rope *rope;
+  int tabSize;
+  bool typing;
+  EditorRow *current;
+  EditorRow *previous;
 };
 
-RowList *rowListCons(EditorRow *head, RowList *tail);
-
-RowList *rowListDrop(RowList *list, int n);
+/**
+ * A buffer holding rows (it takes its own reference to them).
+ */
+ZipperBuffer *zipperBuffer(RowTree *rows, int64_t cursor);
 
 /**
- * True if x is newer than y, false otherwise.
+ * A buffer whose text is in rope (it takes its own reference to it), which
+ * must be empty or end in a '\n'. Rows made from it have tabs tabSize wide.
  */
-bool rowListNewer(RowList *x, RowList *y);
+ZipperBuffer *zipperRopeBuffer(Rope *rope, int64_t cursor, int tabSize);
 
-void updateRowList(RowList *toUpdate, EditorRow *newHead, RowList *newTail);
+bool zipperIsRope(ZipperBuffer *buffer);
+
+int64_t zipperLength(ZipperBuffer *buffer);
 
 /**
- * Reverses a RowList by mutating it. Returns the new head.
+ * Switch to another version of the rows (e.g. from the undo history), with
+ * the cursor on the row at cursor.
  */
-RowList *rowListReverse(RowList *rows);
+void zipperSetRows(ZipperBuffer *buffer, RowTree *rows, int64_t cursor);
 
-typedef struct ZipperBuffer ZipperBuffer;
+/**
+ * Switch a rope buffer to another version of its text, as zipperSetRows.
+ */
+void zipperSetRope(ZipperBuffer *buffer, Rope *rope, int64_t cursor);
 
-struct ZipperBuffer {
-  RowList *forwards;
-  RowList *backwards;
-  RowList *newest;
-};
+/**
+ * Add lines from to to of file after the last row, leaving the cursor (and
+ * the row being typed on) where they are. Rope buffers hold the whole file
+ * from the start, so they're never added to.
+ */
+void zipperAppendLines(ZipperBuffer *buffer, MappedFile *file, int64_t from, int64_t to);
 
 void zipperForwardRow(ZipperBuffer *buffer);
 
-void zipperForwardN(ZipperBuffer *buffer, int n);
+void zipperForwardN(ZipperBuffer *buffer, int64_t n);
 
 void zipperBackwardRow(ZipperBuffer *buffer);
 
-void zipperBackwardN(ZipperBuffer *buffer, int n);
+void zipperBackwardN(ZipperBuffer *buffer, int64_t n);
 
+/**
+ * Move the cursor to the row at index, clipped to the buffer.
+ */
+void zipperJumpTo(ZipperBuffer *buffer, int64_t index);
+
+/**
+ * The row the cursor is on, or NULL if it's past the last row. If the row
+ * is open, it's closed first, which copies it. For a rope, the row is a copy
+ * of the line, which lasts until the rope or the cursor changes.
+ */
+EditorRow *zipperCurrentRow(ZipperBuffer *buffer);
+
+/**
+ * Number of characters in the row the cursor is on, or -1 if it's past the
+ * last row. Doesn't close the row if it's open, so the cursor can move along
+ * a row being typed on without copying it.
+ */
+int64_t zipperCurrentLength(ZipperBuffer *buffer);
+
+/**
+ * The row before the cursor, or NULL if the cursor is on the first row. For
+ * a rope, it lasts as zipperCurrentRow's does.
+ */
+EditorRow *zipperPreviousRow(ZipperBuffer *buffer);
+
+/**
+ * Insert a row at the cursor, so that it becomes the current row.
+ */
 void zipperInsertRow(ZipperBuffer *buffer, EditorRow *r);
 
-RowList *zipperRowsFrom(ZipperBuffer *buffer, int cursorY, int n);
+/**
+ * Insert a row after the last row, without moving the cursor.
+ */
+void zipperAppendRow(ZipperBuffer *buffer, EditorRow *r);
 
-void zipperUpdateNewest(ZipperBuffer *buffer);
+/**
+ * Replace the current row, or insert r if the cursor is past the last row.
+ */
+void zipperReplaceRow(ZipperBuffer *buffer, EditorRow *r);
 
-void printRowList(RowList *list);
+/**
+ * Delete the row at index, keeping the cursor on the same row if it's still
+ * there.
+ */
+void zipperDeleteRow(ZipperBuffer *buffer, int64_t index);
 
-void printZipperBuffer(ZipperBuffer *buffer);
+/**
+ * Insert c before the character at index at in the current row, opening the
+ * row for editing if it isn't already. The cursor must be on a row.
+ */
+void zipperInsertChar(ZipperBuffer *buffer, int64_t at, char c);
 
-ZipperBuffer *exampleBuffer();
+/**
+ * Delete the character before index at in the current row, opening the row
+ * for editing if it isn't already. The cursor must be on a row.
+ */
+void zipperDeleteChar(ZipperBuffer *buffer, int64_t at);
+
+bool zipperRowIsOpen(ZipperBuffer *buffer);
+
+/**
+ * Put the row being edited (if any) back into rows as a new row.
+ */
+void zipperCloseRow(ZipperBuffer *buffer);
+
+/**
+ * Screen column of the character at index at in the current row, without
+ * closing the row if it's open.
+ */
+int64_t zipperCursorToRender(ZipperBuffer *buffer, int64_t at, int tabSize);
+
+/**
+ * Iterate over the rows starting from the row at index n. If the current row
+ * is open, the iterator gives its old version. A rope buffer has no rows to
+ * iterate over: its lines are read from the rope (see ropeRender).
+ */
+RowIterator zipperRowsFrom(ZipperBuffer *buffer, int64_t n);
 
-int testZipperBuffer();
+void printZipperBuffer(ZipperBuffer *buffer);
 
 #endif